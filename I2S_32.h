@@ -44,6 +44,7 @@ public:
   void begin(void);
   virtual void update(void);
   void digitalShift(int16_t val){I2S_32::shift=val;}
+  static volatile uint32_t allocFail; // number of updates without free audio block
   
 protected:  
   static bool update_responsibility;
@@ -68,6 +69,7 @@ audio_block_t * I2S_32:: block_right = NULL;
 uint16_t I2S_32:: block_offset = 0;
 bool I2S_32::update_responsibility = false;
 DMAChannel I2S_32::dma(false);
+volatile uint32_t I2S_32::allocFail = 0;
 
 void I2S_32::begin(void)
 { 
@@ -155,6 +157,7 @@ void I2S_32::update(void)
       new_left = NULL;
     }
   }
+  if ((new_left == NULL) || (new_right == NULL)) allocFail++;
   __disable_irq();
   if (block_offset >= AUDIO_BLOCK_SAMPLES) {
     // the DMA filled 2 blocks, so grab them and get the
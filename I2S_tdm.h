@@ -43,6 +43,7 @@ public:
 	virtual void update(void);
 	void begin(void);
   void digitalShift(int16_t val){I2S_TDM::shift=val;}
+  static volatile uint32_t allocFail; // number of updates without free audio blocks
 protected:	
 	static bool update_responsibility;
 	static DMAChannel dma;
@@ -59,6 +60,7 @@ audio_block_t * I2S_TDM::block_incoming[NBL] = { NULL, NULL, NULL, NULL, NULL };
 bool I2S_TDM::update_responsibility = false;
 DMAChannel I2S_TDM::dma(false);
 int16_t I2S_TDM::shift=8; //8 shifts 24 bit data to LSB
+volatile uint32_t I2S_TDM::allocFail = 0;
 
 
 void I2S_TDM::begin(void)
@@ -134,6 +136,7 @@ void I2S_TDM::update(void)
 				release(new_block[jj]);
 			}
 			memset(new_block, 0, sizeof(new_block));
+			allocFail++;
 			break;
 		}
 	}
@@ -31,6 +31,7 @@
 #include "kinetis.h"
 #include "core_pins.h"
 #include "TimeLib.h"
+#include "m_schedule.h"
 
 /******************* Seting Alarm **************************/
 #define RTC_IER_TAIE_MASK       0x4u
@@ -109,6 +110,23 @@ static void llwuSetup(void)
 #define VLLS0 0x0 // all stop
 
 #define VLLS_MODE VLLS0
+#define LLS_MODE 0x3 // STOPM for LLS: RAM and registers retained, wake-up continues after wfi
+
+#ifndef FAST_RESUME
+  #define FAST_RESUME 0
+#endif
+
+// return to PEE mode after LLS (MCG exits LLS in PBE mode, PLL has to relock)
+static void resumeClocks(void)
+{
+  while(!(MCG_S & MCG_S_LOCK0)) ;
+  MCG_C1 &= ~MCG_C1_CLKS_MASK; // select PLL output
+  while((MCG_S & MCG_S_CLKST_MASK) != MCG_S_CLKST(3)) ;
+#if defined(HAS_KINETIS_HSRUN) && (F_CPU > 120000000)
+  kinetis_hsrun_enable( );
+#endif
+}
+
 static void gotoSleep(void)
 {  
 //  /* Make sure clock monitor is off so we don't get spurious reset */
@@ -122,11 +140,15 @@ static void gotoSleep(void)
 #endif   
    /* Write to PMPROT to allow all possible power modes */
    SMC_PMPROT = SMC_PMPROT_AVLLS_MASK;
-   /* Set the STOPM field to 0b100 for VLLSx mode */
    SMC_PMCTRL &= ~SMC_PMCTRL_STOPM_MASK;
+#if FAST_RESUME
+   SMC_PMCTRL |= SMC_PMCTRL_STOPM(LLS_MODE); // LLS
+#else
+   /* Set the STOPM field to 0b100 for VLLSx mode */
    SMC_PMCTRL |= SMC_PMCTRL_STOPM(0x4); // VLLSx
 
    SMC_VLLSCTRL =  SMC_VLLSCTRL_VLLSM(VLLS_MODE);
+#endif
    /*wait for write to complete to SMC before stopping core */
    (void) SMC_PMCTRL;
 
@@ -134,11 +156,23 @@ static void gotoSleep(void)
    SCB_SCR |= SCB_SCR_SLEEPDEEP_MASK;  // Set the SLEEPDEEP bit to enable deep sleep mode (STOP)
    
    asm volatile( "wfi" );  // WFI instruction will start entry into STOP mode
-   // will never return, but wake-up results in call to ResetHandler() in mk20dx128.c
+   // VLLSx: will never return, but wake-up results in call to ResetHandler() in mk20dx128.c
+#if FAST_RESUME
+   // LLS: continue here after llwuISR
+   SCB_SCR &= ~SCB_SCR_SLEEPDEEP_MASK;
+   resumeClocks();
+   SYST_CSR |= SYST_CSR_TICKINT;
+   setTime(rtc_get()); // millis() did not advance while sleeping
+#endif
 }
 
+// returns only with FAST_RESUME (caller has to restart acquisition)
 void setWakeupCallandSleep(uint32_t nsec)
 {  // set alarm to nsec secods in future and go to hibernate
+#if FAST_RESUME
+   // llwuSetup disables these pins, restore them after wake-up
+   uint32_t pcr[6] = {PORTA_PCR0, PORTA_PCR1, PORTA_PCR2, PORTA_PCR3, PORTB_PCR2, PORTB_PCR3};
+#endif
    rtcSetup();
    llwuSetup();  
    rtcSetAlarm(nsec);
@@ -148,6 +182,10 @@ void setWakeupCallandSleep(uint32_t nsec)
    pinMode(13,OUTPUT); digitalWriteFast(13,HIGH); delay(1000); digitalWriteFast(13,LOW);
 #endif
    gotoSleep();
+#if FAST_RESUME
+   PORTA_PCR0=pcr[0]; PORTA_PCR1=pcr[1]; PORTA_PCR2=pcr[2]; PORTA_PCR3=pcr[3];
+   PORTB_PCR2=pcr[4]; PORTB_PCR3=pcr[5];
+#endif
 }
 
 /***********************************************************************************************/
@@ -159,26 +197,53 @@ void setWakeupCallandSleep(uint32_t nsec)
   #define ShortSleepDuration 60   // i.e. wake up every 'ShortSleepDuration' seconds
 #endif
 //
+mSchedule schedule; // recording windows (Schedule.txt or T1-T4 of acqParameters, see m_schedule.h)
+
+/************************* activity-adaptive sleep (ADAPT_DUTY) *********************************/
+#ifndef ADAPT_DUTY
+  #define ADAPT_DUTY 0
+#endif
+#ifndef ADAPT_RANGE
+  #define ADAPT_RANGE 4
+#endif
+// system register file (32 bytes, kept in VLLSx, cleared by power-on reset)
+#define RFSYS_REG(n)  (*(volatile uint32_t *)(0x40041000 + 4*(n)))
+#define ADAPT_MAGIC   0xAD000000u
+
+static uint32_t adaptBlocks=0, adaptDet=0; // blocks and detected blocks of actual recording cycle
+
+// to be called for every processed block (det: detector has signal)
+void dutyActivity(int16_t det)
+{ adaptBlocks++;
+  if(det) adaptDet++;
+}
+
+// sleep stretch in 1/256 (survives VLLS0 wake-up in RFSYS)
+static uint32_t dutyScale(void)
+{ uint32_t reg=RFSYS_REG(0);
+  return ((reg & 0xff000000u)==ADAPT_MAGIC)? (reg & 0xffffff): 256;
+}
+
+// update sleep stretch at end of recording cycle (half way in log scale towards target/density)
+static void adaptDutyCycle(void)
+{ float scale = dutyScale()/256.0f;
+  float ratio = (adaptDet>0)? (float)ADAPT_DUTY*adaptBlocks/(100.0f*adaptDet): (float)ADAPT_RANGE;
+  scale = sqrtf(scale*ratio);
+  if(scale>ADAPT_RANGE) scale=ADAPT_RANGE;
+  if(scale<1.0f/ADAPT_RANGE) scale=1.0f/ADAPT_RANGE;
+  RFSYS_REG(0) = ADAPT_MAGIC | (uint32_t)(scale*256.0f+0.5f);
+  adaptBlocks=adaptDet=0;
+}
+
 // flag can be 0 file to be open // time to shutdown if required
 int32_t checkDutyCycle(ACQ_Parameters_s *acqParameters,int16_t flag)
 {	static uint32_t t_start = 0;  // start of actual file
   static uint16_t recording = 0;  // acquisition has started
 
   uint32_t tt = now();
-  uint16_t to = hour();
   
-  // check if we should sleep longer
-  // sleep time between T2 and T3 and T4 and T1 (values are in hours)
-  
-  uint16_t T1 = acqParameters->T1;
-  uint16_t T2 = acqParameters->T2;
-  uint16_t T3 = acqParameters->T3;
-  uint16_t T4 = acqParameters->T4;
-  uint16_t doRecording=1;
-  if (T4<T1) // e.g. 3-4, 23-1 (work over midnight)
-    doRecording =   ((to>=T3) || (to<T4) || ((to>=T1) && (to<T2)));
-  else		// e.g. 3-4, 23-24
-    doRecording = (((to>=T1) && (to<T2)) || ((to>=T3) && (to<T4)));
+  // check if we should sleep longer (outside of schedule windows)
+  uint16_t doRecording = schedule.isActive(tt);
 
   uint32_t nsec=0;
   if (doRecording) // we can record
@@ -218,6 +283,11 @@ int32_t checkDutyCycle(ACQ_Parameters_s *acqParameters,int16_t flag)
         if ((t_rep>t_on) && (tt >= t_rec + t_on))
         { // need to stop
           nsec = (t_rec + t_rep - tt);
+          #if ADAPT_DUTY>0
+            adaptDutyCycle();
+            uint32_t nsleep = ((t_rep-t_on)*dutyScale())/256;
+            nsec = (tt-t_rec-t_on < nsleep)? nsleep-(tt-t_rec-t_on): 1;
+          #endif
           #ifdef SLEEP_SHORT
             if(nsec>ShortSleepDuration) nsec=ShortSleepDuration;
           #endif
@@ -229,8 +299,12 @@ int32_t checkDutyCycle(ACQ_Parameters_s *acqParameters,int16_t flag)
             logFile.println(nsec); 
             logFile.println("Hibernate now 1");
           #endif
+          recording=0; // next wake-up starts new cycle (also without reboot)
           return nsec; 
         }
+        #if ADAPT_DUTY>0
+          else t_start = tt; // detector opens files at any time of the cycle: ad counts from the opening frame
+        #endif
       }
     }
     /*
@@ -254,21 +328,8 @@ int32_t checkDutyCycle(ACQ_Parameters_s *acqParameters,int16_t flag)
   }
   else
   {
-    uint32_t tto= tt%(24*3600); // seconds since midnight
-    nsec=0;
-    // estimate next start time
-    if ((to >= T2) && (to<T3))  // sleep during the day  //eg: to=10: T1=4; T2=9; T3=16; T4=20
-    { if(tto < T3 * 3600) 
-      nsec = T3 * 3600 - tto;
-    }
-    //
-    if((to>=T4) && (T4>T1)) // sleep over midnight to T1 //eg: to=21: T1=4; T2=9; T3=16; T4=20
-    {  nsec = (T1+24) * 3600 - tto;
-    }
-    //
-    if(to<T1)                                            //eg: to=2:  T1=4; T2=9; T3=16; T4=20
-    { nsec = T1 * 3600 - tto;
-    }
+    // sleep to start of next window
+    nsec = schedule.nextChange(tt) - tt;
   
     #ifdef SLEEP_SHORT
             if(nsec>ShortSleepDuration) nsec=ShortSleepDuration;
@@ -278,6 +339,7 @@ int32_t checkDutyCycle(ACQ_Parameters_s *acqParameters,int16_t flag)
     Serial.println(nsec); 
     Serial.println("Hibernate now 3");
 #endif
+    recording=0;
     return nsec;
   }
   return 0;
@@ -31,6 +31,7 @@
 // to avoid confict with stock SD library needed for Audio library
 //
 #include "SdFat.h" 
+#include "m_config.h"
 
 FsFile logFile;
 
@@ -60,14 +61,18 @@ class c_uSD
   private:
     SdFs sd;
     FsFile file;
+    FsFile sideFile; // side files that are written while a data file is open
     
   public:
-    c_uSD(): state(-1), closing(0) {;}
+    c_uSD(): state(-1), closing(0), noise(0), fileNoise(0), reject(0), cfgSaved(0) {;}
     void init();
     int16_t write(int16_t * data, int32_t ndat);
     uint16_t getNbuf(void) {return nbuf;}
     void setClosing(void) {closing=1;}
     int16_t isClosing(void) {return closing;}
+    void setNoise(int16_t val) {noise=val;}
+    void setReject(int16_t val) {reject=val;}
+    char *getFilename(void) {return filename;}
 
     int16_t close(void);
     void setPrefix(char *prefix);
@@ -75,14 +80,32 @@ class c_uSD
     int16_t state; // 0 initialized; 1 file open; 2 data written; 3 to be closed
     int16_t nbuf;
     int16_t closing;
+    int16_t noise;     // next file is noise only
+    int16_t fileNoise; // open file was started as noise only
+    int16_t reject;    // remove file on close (classifier, noise snippets are kept)
 
     char name[8];
+    char filename[40];
+    ACQ_Parameters_s cfgAcq;   // values last loaded or stored (m_config.h)
+    SNIP_Parameters_s cfgSnip;
+    int16_t cfgSaved;          // Config.txt holds cfgAcq/cfgSnip
 //    char buffer[512];
     
   public:
-  void loadConfig(uint32_t * param1, int n1, int32_t *param2, int n2);
-  void storeConfig(uint32_t * param1, int n1, int32_t *param2, int n2);
+  void loadConfig(ACQ_Parameters_s *acq, SNIP_Parameters_s *snip);
+  void storeConfig(ACQ_Parameters_s *acq, SNIP_Parameters_s *snip);
   void writeTemperature(float temperature, float pressure, float humidity, uint16_t lux);
+  void writeEvents(void *data, int32_t nbytes);
+  int32_t readFile(const char *fname, void *data, int32_t nmax);
+  void writeLtsa(void *data, int32_t nbytes);
+  void writeBoot(void *data, int32_t nbytes);
+  void writePower(void *data, int32_t nbytes);
+  // data offload (menu mode, see m_proto.h)
+  int16_t listFiles(uint8_t *data, int32_t nmax, uint16_t start, int32_t *nbytes);
+  int32_t openRead(const char *fname);
+  int32_t readAt(uint32_t offset, void *data, int32_t nbytes);
+  void closeRead(void) {sideFile.close();}
+  int16_t removeFile(const char *fname) {return sd.remove(fname);}
 };
 c_uSD uSD;
 
@@ -106,11 +129,13 @@ c_uSD uSD;
   *ms10 = second() & 1 ? 100 : 0;
 }
 
-char *makeFilename(char * prefix)
+// noise only snippets are marked with "_N" before postfix
+#define NOISE_MARK "_N"
+char *makeFilename(char * prefix, int16_t noise=0)
 { static char filename[40];
 
-  sprintf(filename, "%s_%04d_%02d_%02d_%02d_%02d_%02d%s", prefix, 
-                    year(), month(), day(), hour(), minute(), second(), postfix);
+  sprintf(filename, "%s_%04d_%02d_%02d_%02d_%02d_%02d%s%s", prefix, 
+                    year(), month(), day(), hour(), minute(), second(), noise? NOISE_MARK: "", postfix);
   #if DO_DEBUG>0
     Serial.println(filename);
   #endif
@@ -189,7 +214,7 @@ void c_uSD::init()
 */
 void c_uSD::init()
 {
-  delay(200);
+  if(!(RCM_SRS0 & RCM_SRS0_WAKEUP)) delay(200); // power-up delay of card, not needed on wake-up from VLLSx (card stayed powered)
   int SD_success = 0;
   char text[32];
   char SD_filename[24];
@@ -234,8 +259,10 @@ int16_t c_uSD::write(int16_t *data, int32_t ndat)
 {
   if(state == 0)
   { // open file
-    char *filename = makeFilename(name);
-    if(!filename) {state=-1; return state;} // flag to do not anything
+    char *fname = makeFilename(name, noise);
+    if(!fname) {state=-1; return state;} // flag to do not anything
+    strcpy(filename,fname);
+    fileNoise=noise;
     //
     if (!file.open(filename, O_CREAT | O_TRUNC |O_RDWR)) sd.errorHalt("file.open failed");
     if (!file.preAllocate(PRE_ALLOCATE_SIZE)) sd.errorHalt("file.preAllocate failed");
@@ -270,7 +297,22 @@ int16_t c_uSD::close(void)
        file.write(header,512);
        file.seek(fileSize);
     #endif
-    file.close();
+    if(reject && !noise)
+    { // classifier rejected detection: remove file
+      file.remove();
+    }
+    else
+    {
+      if(fileNoise && !noise)
+      { // noise snippet turned into detection: remove noise mark from file name
+        char *mark = filename + strlen(filename) - strlen(postfix) - strlen(NOISE_MARK);
+        strcpy(mark, postfix);
+        file.rename(filename);
+      }
+      file.close();
+    }
+    fileNoise=0;
+    reject=0;
 //#if DO_DEBUG>0
 //    Serial.println("file Closed");    
 //#endif
@@ -278,39 +320,33 @@ int16_t c_uSD::close(void)
     return state;
 }
 
-void c_uSD::storeConfig(uint32_t * param1, int n1, int32_t *param2, int n2)
-{ char text[32];
-  file.open("Config.txt", O_CREAT|O_WRITE|O_TRUNC);
-  for(int ii=0; ii<n1; ii++)
-  { sprintf(text,"%10d\r\n",(int) param1[ii]); file.write((uint8_t*)text,strlen(text));
-  }
-//
-  for(int ii=0; ii<n2; ii++)
-  { sprintf(text,"%10d\r\n",(int) param2[ii]); file.write((uint8_t*)text,strlen(text));
-  }
-  sprintf(text,"%s\r\n",(char*) &param1[n1]);
-  file.write((uint8_t *)text,6);
-
+// write Config.txt (m_config.h) only if values differ from those last loaded or stored
+void c_uSD::storeConfig(ACQ_Parameters_s *acq, SNIP_Parameters_s *snip)
+{ 
+  if(cfgSaved && !memcmp(acq, &cfgAcq, sizeof(cfgAcq)) && !memcmp(snip, &cfgSnip, sizeof(cfgSnip))) return;
+  char text[CFG_MAXTEXT];
+  int32_t nbytes=cfgFormat(text, sizeof(text), acq, snip);
+  if(!file.open("Config.txt", O_CREAT|O_WRITE|O_TRUNC)) return;
+  int32_t nw=file.write((uint8_t *)text, nbytes);
   file.close();
-  
+  if(nw!=nbytes) return;
+  cfgAcq=*acq; cfgSnip=*snip;
+  cfgSaved=1;
 }
 
-void c_uSD::loadConfig(uint32_t * param1, int n1, int32_t *param2, int n2)
+// read Config.txt with one read; keeps compiled defaults if file is missing or rejected
+void c_uSD::loadConfig(ACQ_Parameters_s *acq, SNIP_Parameters_s *snip)
 {
-  char text[32];
-  if(!file.open("Config.txt",O_RDONLY)) return;
-  //
-  for(int ii=0; ii<n1; ii++)
-  { if(file.read((uint8_t*)text,12)>0) sscanf(text,"%d",(int *) &param1[ii]);
-  }
-  for(int ii=0; ii<n2; ii++)
-  { if(file.read((uint8_t*)text,12)>0) sscanf(text,"%d", (int *)&param2[ii]);
-  }
-  if(file.read((uint8_t *)text,6))
-  { text[5]=0;
-    sscanf(text,"%s",(char *) &param1[n1]);
-  }  
-  file.close();
+  char text[CFG_MAXTEXT];
+  const char *err="";
+  int32_t nbytes=readFile("Config.txt", text, sizeof(text)-1);
+  if(nbytes<0) nbytes=0;
+  text[nbytes]=0;
+  int16_t ret = (nbytes>0)? cfgParse(text, nbytes, acq, snip, &err): 0;
+  if(nbytes>0 && !ret) Serial.printf("Config.txt rejected (%s), using defaults\r\n", err);
+  // shadow copy: previous format or defaults are written with the next storeConfig
+  cfgAcq=*acq; cfgSnip=*snip;
+  cfgSaved=(ret==1);
 }
 
 // DD4WH, 24.5.2018
@@ -345,4 +381,99 @@ void c_uSD::writeTemperature(float temperature, float pressure, float humidity,
   file.close(); 
 }
 
+// append event records (see m_events.h) to event index file
+// must only be called when no data file is open
+void c_uSD::writeEvents(void *data, int32_t nbytes)
+{
+  char evtfilename[24];
+  sprintf(evtfilename, "Events_%s.bin", acqParameters.name);
+  if(!file.open(evtfilename, O_CREAT|O_WRITE|O_APPEND)) return;
+  file.write((char *)data, nbytes);
+  file.close();
+}
+
+// append LTSA records (see m_ltsa.h) to LTSA file
+// uses own file object, so may be called while a data file is open
+void c_uSD::writeLtsa(void *data, int32_t nbytes)
+{
+  char ltsafilename[24];
+  if(nbytes<=0) return;
+  sprintf(ltsafilename, "LTSA_%s.bin", acqParameters.name);
+  if(!sideFile.open(ltsafilename, O_CREAT|O_WRITE|O_APPEND)) return;
+  sideFile.write((char *)data, nbytes);
+  sideFile.close();
+}
+
+// append boot profile record (see m_boot.h)
+// uses own file object, so may be called while a data file is open
+void c_uSD::writeBoot(void *data, int32_t nbytes)
+{
+  char bootfilename[24];
+  sprintf(bootfilename, "Boot_%s.bin", acqParameters.name);
+  if(!sideFile.open(bootfilename, O_CREAT|O_WRITE|O_APPEND)) return;
+  sideFile.write((char *)data, nbytes);
+  sideFile.close();
+}
+
+// append power record (see m_power.h)
+// uses own file object, so may be called while a data file is open
+void c_uSD::writePower(void *data, int32_t nbytes)
+{
+  char pwrfilename[24];
+  sprintf(pwrfilename, "Power_%s.bin", acqParameters.name);
+  if(!sideFile.open(pwrfilename, O_CREAT|O_WRITE|O_APPEND)) return;
+  sideFile.write((char *)data, nbytes);
+  sideFile.close();
+}
+
+// directory listing of root from file index start: entries {uint32 size; uint8 n; char name[n]}
+// returns number of entries that fit into nmax bytes (0: end of directory)
+int16_t c_uSD::listFiles(uint8_t *data, int32_t nmax, uint16_t start, int32_t *nbytes)
+{
+  FsFile dir, entry;
+  char fname[64];
+  int16_t count=0;
+  uint16_t index=0;
+  *nbytes=0;
+  if(!dir.open("/", O_RDONLY)) return 0;
+  while(entry.openNext(&dir, O_RDONLY))
+  { if(!entry.isDir() && (index++ >= start))
+    { uint8_t n=entry.getName(fname, sizeof(fname));
+      if(*nbytes+5+n > nmax) { entry.close(); break;}
+      uint32_t size=entry.fileSize();
+      memcpy(data+*nbytes, &size, 4);
+      data[*nbytes+4]=n;
+      memcpy(data+*nbytes+5, fname, n);
+      *nbytes += 5+n;
+      count++;
+    }
+    entry.close();
+  }
+  dir.close();
+  return count;
+}
+
+// open file for offload; returns size, -1 if not found
+int32_t c_uSD::openRead(const char *fname)
+{
+  if(!sideFile.open(fname, O_RDONLY)) return -1;
+  return sideFile.fileSize();
+}
+
+int32_t c_uSD::readAt(uint32_t offset, void *data, int32_t nbytes)
+{
+  if(!sideFile.seekSet(offset)) return -1;
+  return sideFile.read(data, nbytes);
+}
+
+// read a whole (small) file into data, returns number of bytes read
+// must only be called when no data file is open
+int32_t c_uSD::readFile(const char *fname, void *data, int32_t nmax)
+{
+  if(!file.open(fname, O_RDONLY)) return 0;
+  int32_t nbytes = file.read(data, nmax);
+  file.close();
+  return (nbytes>0)? nbytes: 0;
+}
+
 #endif
@@ -26,7 +26,21 @@
 //----------------------------------------------------------------------------------------
 #define DO_DEBUG 2 // print debug info over usb-serial line  (2 write also log file)//<<<======>>>
 
+#define TELEMETRY 0 // binary status record every TELEMETRY seconds instead of the DO_DEBUG statistics (0: off, see m_telemetry.h) //<<<======>>>
+#define TEL_OUT 3   // telemetry output: 1 USB serial, 2 ring file on card, 3 both //<<<======>>>
+
 #define F_SAMP 48000 // desired sampling frequency  //<<<======>>>
+
+#define MONITOR 0 // live monitor over USB serial: decimation factor (0: off; e.g. 4 gives 12 kHz at 48 kHz, see m_monitor.h) //<<<======>>>
+                  // must divide 128; data are sent only as USB bandwidth allows (use with DO_DEBUG 0)
+#if (MONITOR>0) && (128 % MONITOR)
+  #error "MONITOR must divide the audio block size (128)"
+#endif
+
+#define CPU_SCALING 0 // 1: run core at bus clock while recording, F_CPU only for file open/close and second stages (see m_power.h) //<<<======>>>
+
+#define FAST_RESUME 0 // 1: hibernate in LLS (RAM kept, no reboot on wake-up, USB serial does not recover) //<<<======>>>
+                      // 0: hibernate in VLLS0 (lowest current, every wake-up reboots and runs setup())
 /*
  * NOTE: changing frequency impacts the macros 
  *      AudioProcessorUsage and AudioProcessorUsageMax
@@ -44,7 +58,7 @@
 #define _I2S_QUAD       5 // I2S (16 bit quad audio)
 #define _I2S_32_MONO    6 // I2S (32 bit mono audio), eg. one ICS43434 mic
 #define _I2S_TYMPAN     7 // I2S (16 bit tympan stereo audio audio) for use the tympan board
-#define _I2S_TDM        8 // I2S (8 channel TDM) // only first 5 channels are used (modify myAcq.h if less or more channels)
+#define _I2S_TDM        8 // I2S (8 channel TDM) // only first 5 channels are used (modify myAPP.cpp if less or more channels)
 #define _I2S_SGTL5000   9 // I2S PJRC Audioboard
 
 #define ACQ  _I2S_32_MONO // selected acquisition interface  //<<<======>>>
@@ -67,8 +81,16 @@
 #define MDEL -1     // maximal delay in buffer counts (128/fs each; for fs= 48 kHz: 128/48 = 2.5 ms each) //<<<======>>>
                     // MDEL == -1 connects ACQ interface directly to mux and queue
                     // MDEL >= 0 switches on event detector
-                    // MDEL > 0 delays detector by MDEL buffers 
+                    // MDEL > 0 delays data by snipParameters.ndel buffers (default MDEL, runtime up to MDEL+MQ/2, menu 'p')
 #define MDET (MDEL>=0)
+#define MCDEL 0     // compressed look-back before the pre-trigger (bytes of RAM, IMA-ADPCM, 0: off; only with MDEL >= 0) //<<<======>>>
+                    // 68 bytes per channel and block, e.g. 65536 bytes hold 1.3 s of stereo at 48 kHz (see m_lookback.h)
+                    // counts against the RAM budget in myAPP.cpp (reduce MAX_Q if static_assert fails)
+#define MSPILL 0    // spill-to-SD look-back before the pre-trigger (seconds, lossless, 0: off; only with MDEL >= 0) //<<<======>>>
+                    // uses a preallocated ring file on the card (see m_spill.h)
+#if (MSPILL>0) && (MCDEL>0)
+  #error "use either MCDEL or MSPILL look-back"
+#endif
 
 #define GEN_WAV_FILE  // generate wave files, if undefined generate raw data (with 512 byte header) //<<<======>>>
 
@@ -79,7 +101,7 @@ typedef struct
 { uint32_t on;  // acquisition on time in seconds
   uint32_t ad;  // acquisition file size in seconds
   uint32_t ar;  // acquisition rate, i.e. every ar seconds (if < on then continuous acquisition)
-  uint32_t T1,T2; // first acquisition window (from T1 to T2) in Hours of day
+  uint32_t T1,T2; // first acquisition window (from T1 to T2) in Hours of day (if no Schedule.txt on card, see m_schedule.h)
   uint32_t T3,T4; // second acquisition window (from T1 to T2) in Hours of day
   uint32_t rec;  // time when recording started
   char name[8];   // prefix for recorder file names
@@ -102,16 +124,23 @@ ACQ_Parameters_s acqParameters = { 300, 300, 3600, 0, 12, 12, 24, 0, "WMXZ"}; //
 
 //---------------------------------- snippet extraction module ---------------------------------------------
 typedef struct
-{  int32_t iproc;      // type of detection processor (0: high-pass-threshold; 1: Taeger-Kaiser-Operator)
+{  int32_t iproc;      // type of detection processor (0: high-pass-threshold; 1: Taeger-Kaiser-Operator; 2: FFT band energy)
    int32_t thresh;     // power SNR for snippet detection (-1: disable snippet extraction)
    int32_t win0;       // noise estimation window (in units of audio blocks)
    int32_t win1;       // detection watchdog window (in units of audio blocks typically 10x win0)
    int32_t extr;       // min extraction window
    int32_t inhib;      // guard window (inhibit follow-on secondary detections)
-   int32_t nrep;       // noise only interval (nrep =0  indicates no noise archiving, TBD)
+   int32_t nrep;       // noise only interval (in units of audio blocks; nrep =0  indicates no noise archiving)
+                       // every nrep blocks without detection a noise only snippet of extr blocks is stored (file name ends with _N)
    int32_t ndel;       // pre trigger delay (in units of audio blocks)
+   int32_t nvote;      // min number of channels that must detect (k-of-NCH vote; 1: any channel)
+   int32_t cfar;       // target trigger rate per hour (0: fixed threshold; >0: adapt threshold, thresh is start value)
+   int32_t nquant;     // noise estimator (0: exponential average over win0/win1; 1-99: percentile of block energy, e.g. 15)
+   int32_t clsf;       // classifier gate (0: keep all detections; 1-100: min classifier score in percent, needs Model.bin on card)
+   int32_t ltsa;       // long-term spectral average interval in seconds (0: no LTSA file; e.g. 10)
 } SNIP_Parameters_s; 
 // Note: 375 blocks is 1s for 48 kHz sampling
+#define N_SNIP_PARAMETERS (sizeof(SNIP_Parameters_s)/sizeof(int32_t))
 
 #if MDEL<0
   // continuous acquisition; disable detector
@@ -120,7 +149,26 @@ typedef struct
   #define THR 100 // detection threshold (on power: 100 == 20 dB) //<<<======>>>
 #endif
 
-SNIP_Parameters_s snipParameters = { 0, THR, 1000, 10000, 38, 375, 0, MDEL}; //<<<======>>>
+SNIP_Parameters_s snipParameters = { 0, THR, 1000, 10000, 38, 375, 0, MDEL, 1, 0, 0, 0, 0}; //<<<======>>>
+
+//---------------------------------- band energy detector (iproc == 2) -------------------------------------
+// energy is estimated with a 128 point FFT per audio block (frequency resolution F_SAMP/128)
+// a channel detects if the energy in any band exceeds 'thresh' times the noise estimate of that band
+#define N_BANDS 3 // number of frequency bands //<<<======>>>
+typedef struct
+{  int32_t f1;         // lower band edge (Hz)
+   int32_t f2;         // upper band edge (Hz)
+   int32_t thresh;     // power SNR for detection in this band (-1: band not used for detection)
+} BAND_Parameters_s;
+
+BAND_Parameters_s bandParameters[N_BANDS] = {{1000, 4000, 100}, {4000, 10000, 100}, {10000, 20000, 100}}; //<<<======>>>
+
+//---------------------------------- second stage classifier (snipParameters.clsf) --------------------------
+#define USE_CLASSIFIER 0 // 1: compile classifier (about 22 kB RAM, needs MDEL >= 0 and Model.bin on card, see m_classifier.h) //<<<======>>>
+#define MCLSF (MDET && (USE_CLASSIFIER>0))
+
+//---------------------------------- long-term spectral average (snipParameters.ltsa) -----------------------
+#define USE_LTSA 0 // 1: compile LTSA (about 6 kB RAM, see m_ltsa.h) //<<<======>>>
 
 
 //-------------------------- hibernate control---------------------------------------------------------------
@@ -130,6 +178,15 @@ SNIP_Parameters_s snipParameters = { 0, THR, 1000, 10000, 38, 375, 0, MDEL}; //<
 //#define SLEEP_SHORT             // comment when sleep duration is not limited   //<<<======>>>
 #define ShortSleepDuration 60   // value in seconds     //<<<======>>>
 
+// activity-adaptive duty cycling (event detector only, MDEL >= 0)
+// sleep between "on" periods (ar-on) is stretched when the fraction of detected blocks in the last cycle
+// is below ADAPT_DUTY (percent) and shortened when it is above, within 1/ADAPT_RANGE .. ADAPT_RANGE
+#define ADAPT_DUTY 0    // target detection density in percent (0: fixed on/ar schedule) //<<<======>>>
+#define ADAPT_RANGE 4   // max stretch (and 1/shortening) of sleep //<<<======>>>
+#if (ADAPT_DUTY>0) && (MDEL<0)
+  #error "ADAPT_DUTY needs the event detector (MDEL >= 0)"
+#endif
+
 //------------------------- Additional sensors ---------------------------------------------------------------
 #define USE_ENVIRONMENTAL_SENSORS 0 // to use environmental sensors set to 1 otherwise set to 0  //<<<======>>>
 
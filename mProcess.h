@@ -26,6 +26,11 @@
 #include "core_pins.h"
 
 #include "AudioStream.h"
+#include "m_bands.h"
+#include "m_cfar.h"
+#include "m_quantile.h"
+#include "m_events.h"
+#include "m_tdoa.h"
 
 extern int16_t mustClose;
 /*
@@ -46,53 +51,155 @@ int32_t aux[AUDIO_BLOCK_SAMPLES];
 
 extern volatile uint32_t maxValue, maxNoise;
 
+// nch: number of input channels (is NCH of acquisition interface)
+// a detection is declared if at least nvote channels exceed the threshold (k-of-N vote)
+// iproc == 2: a channel detects if any band of bandParameters exceeds its own threshold
+// cfar > 0: threshold is adapted to reach 'cfar' triggers per hour (see m_cfar.h)
+// nquant > 0: noise is the nquant percentile of block energy (see m_quantile.h)
+// nrep > 0: after nrep blocks without storage a noise only snippet of extr blocks is stored
+// each trigger generates an event record that loop() fetches with getEvent() when storage ends
+// for nch>1 loop() should call doTdoa() to add the channel delays to the event record
+template <int nch>
 class mProcess: public AudioStream
 {
+  static_assert(nch<=8, "mProcess: event records hold tdoa of at most 8 channels");
 public:
 
-  mProcess(SNIP_Parameters_s *param) : AudioStream(2, inputQueueArray) {}
+  mProcess(SNIP_Parameters_s *param) : AudioStream(nch, inputQueueArray) {}
   void begin(SNIP_Parameters_s *param);
   virtual void update(void);
-  void setThreshold(int32_t val) {thresh=val;}
+  void setThreshold(int32_t val) {thresh=val; thr=val;}
+  int32_t getThreshold(void) {return thr;}
   int32_t getSigCount(void) {return sigCount;}
   int32_t getDetCount(void) {return detCount;}
+  int16_t isNoise(void) {return noise;}
   void resetDetCount(void) {detCount=0;}
+  uint32_t getCycles(void) {return cycMax;}
+  void resetCycles(void) {cycMax=0;}
+  int16_t getEvent(EVENT_Record_s *ev);
+  void doTdoa(void);
+  int16_t isTdoaReady(void) {return tdoa.isReady();}
   
 protected:  
-  audio_block_t *inputQueueArray[2];
+  audio_block_t *inputQueueArray[nch];
 
 private:
   int32_t sigCount;
   int32_t detCount;
-  int32_t max1Val, max2Val, avg1Val, avg2Val;
+  uint32_t cycMax;     // max CPU cycles of update() (measured with the DWT cycle counter)
+  int32_t maxVal[nch], avgVal[nch];
+  int32_t bandVal[nch][N_BANDS];
   //
+   int32_t iproc;      // type of detection processor
    int32_t thresh;  // power SNR for snippet detection
    int32_t win0;       // noise estimation window (in units of audio blocks)
    int32_t win1;       // detection watchdog window (in units of audio blocks typicaly 10x win0)
    int32_t extr;       // min extraction window 
    int32_t inhib;      // guard window (inhibit followon secondary detections)
    int32_t ndel;       // pre detection delays in block 
+   int32_t nrep;       // noise only interval (0: no noise archiving)
+   int32_t nvote;      // number of channels that must detect (k-of-N vote)
+   int32_t cfarRate;   // target trigger rate per hour (0: fixed threshold)
+   int32_t nquant;     // noise percentile (0: exponential average)
   //
-  int32_t nest1, nest2;// background noise estimate
-     
+  int32_t thr;         // actual threshold (is thresh, or adapted if cfarRate>0)
+  int32_t lstat[nch];  // detector statistic (log2 of SNR, see mLog2q3)
+  int32_t blockCount;
+  mCfar cfar;
+  //
+  int32_t noiseCount;  // blocks since last storage
+  int16_t noise;       // actual snippet is noise only
+  //
+  uint32_t blockIndex; // blocks since begin
+  EVENT_Record_s event; // actual event
+  EVENT_Record_s evQueue[NEVENTS]; // finished events (to be fetched by loop)
+  volatile uint16_t evHead, evTail;
+  mTdoa<nch> tdoa;
+  //
+  int32_t nest[nch];   // background noise estimate (one per channel)
+  int64_t nband[nch][N_BANDS]; // background noise estimate (one per channel and band, 8 fractional bits)
+  int32_t lnest[nch], lnband[nch][N_BANDS]; // log2 of noise estimates (quantile estimator)
+  mQuantile quant;
+  //
+  mBands<N_BANDS> bands;
 };
  
-void mProcess::begin(SNIP_Parameters_s *param)
+template <int nch>
+void mProcess<nch>::begin(SNIP_Parameters_s *param)
 {  
 //  blockCount=0;
   
+  iproc=param->iproc;
   thresh=param->thresh;
   win0=param->win0;
   win1=param->win1;
   extr=param->extr;
   inhib=param->inhib;
   ndel=param->ndel;
+  nrep=param->nrep;
+  noiseCount=0;
+  noise=0;
+
+  nvote=param->nvote;
+  if(nvote<1) nvote=1;
+  if(nvote>nch) nvote=nch;
+
+  thr=thresh;
+  cfarRate=param->cfar;
+  if(cfarRate>0) cfar.begin(cfarRate, ((uint32_t)F_SAMP*3600)/AUDIO_BLOCK_SAMPLES, thresh);
+  blockCount=0;
 
   sigCount= -1; // start with no detection
   detCount=0;
+  cycMax=0;
 
-  nest1=1<<10;
-  nest2=1<<10;
+  blockIndex=0;
+  evHead=evTail=0;
+  tdoa.begin();
+
+  for(int ii=0; ii<nch; ii++) nest[ii]=1<<10;
+
+  if(iproc==2)
+  { bands.begin(bandParameters, N_BANDS, F_SAMP);
+    for(int ii=0; ii<nch; ii++) for(int jj=0; jj<N_BANDS; jj++) nband[ii][jj]=1<<10;
+  }
+
+  nquant=param->nquant;
+  if(nquant>0)
+  { quant.begin(nquant, win0, win1);
+    for(int ii=0; ii<nch; ii++)
+    { lnest[ii]=mLog2q16(nest[ii]);
+      for(int jj=0; jj<N_BANDS; jj++) lnband[ii][jj]=mLog2q16(nband[ii][jj]>>8);
+    }
+  }
+}
+
+template <int nch>
+int16_t mProcess<nch>::getEvent(EVENT_Record_s *ev)
+{ uint16_t t = evTail;
+  if(t == evHead) return 0;
+  t = (t+1) % NEVENTS;
+  *ev = evQueue[t];
+  evTail = t;
+  return 1;
+}
+
+// to be called from loop(): estimate TDOA of last trigger and add to its event record
+template <int nch>
+void mProcess<nch>::doTdoa(void)
+{ if(!tdoa.isReady()) return;
+  int16_t res[7]={0,0,0,0,0,0,0};
+  tdoa.compute(res);
+  uint32_t block=tdoa.getBlock();
+  __disable_irq();
+  if(event.block==block)
+    for(int ii=0; ii<7; ii++) event.tdoa[ii]=res[ii];
+  // event may have ended already
+  for(uint16_t t=evTail; t!=evHead; )
+  { t=(t+1)%NEVENTS;
+    if(evQueue[t].block==block) for(int ii=0; ii<7; ii++) evQueue[t].tdoa[ii]=res[ii];
+  }
+  __enable_irq();
 }
 
 // 6dB/octave high-pass filter
@@ -116,88 +223,208 @@ inline int32_t avg(int32_t *aux, int16_t ndat)
   return avg/ndat;
 }
 
-void mProcess::update(void)
+template <int nch>
+void mProcess<nch>::update(void)
 {
-  audio_block_t *inp1, *inp2;//, *tmp1, *tmp2;
-  inp1=receiveReadOnly(0);
-  inp2=receiveReadOnly(1);
+  audio_block_t *inp[nch];
+  int16_t nblk=0;
+  for(int ii=0; ii<nch; ii++)
+  { inp[ii]=receiveReadOnly(ii);
+    if(inp[ii]) nblk++;
+  }
   
-  if(!inp1 && !inp2) return; // have no input data
+  if(!nblk) return; // have no input data
   if(thresh<0) // don't run detector
   {
-    if(inp1) release(inp1);
-    if(inp2) release(inp2);
+    for(int ii=0; ii<nch; ii++) if(inp[ii]) release(inp[ii]);
     return;
   }
+  uint32_t cyc0=ARM_DWT_CYCCNT;
   
   // do here something useful with data 
-  // example is a simple threshold detector on both channels
+  // example is a simple threshold detector on all channels
   // simple high-pass filter (6 db/octave)
   // followed by threshold detector
 
   int16_t ndat = AUDIO_BLOCK_SAMPLES;
   //
-  // first channel
-  if(inp1)
+  for(int ii=0; ii<nch; ii++)
   {
-    mDiff(aux, inp1->data, ndat, 0);
-    max1Val = mSig(aux, ndat);
-    avg1Val = avg(aux, ndat);
+    if(inp[ii])
+    {
+      if(iproc==2)
+      { bands.process(inp[ii]->data, bandVal[ii]);
+      }
+      else
+      {
+        mDiff(aux, inp[ii]->data, ndat, 0);
+        maxVal[ii] = mSig(aux, ndat);
+        avgVal[ii] = avg(aux, ndat);
+      }
+    }
+    else
+    {
+      maxVal[ii] = 0;
+      avgVal[ii] = 0;
+      for(int jj=0; jj<N_BANDS; jj++) bandVal[ii][jj]=0;
+    }
   }
-  else
-  {
-    max1Val = 0;
-    avg1Val = 0;
-  }
-  
-  // second channel
-  if(inp2)
-  {
-    mDiff(aux, inp2->data, ndat, 0);//out2? out2->data[ndat-1]: tmp2->data[0]);
-    max2Val = mSig(aux, ndat);
-    avg2Val = avg(aux, ndat);
+
+  // count channels that exceed threshold
+  int32_t ndet=0;
+  uint16_t chanMask=0;
+  if(iproc==2)
+  { for(int ii=0; ii<nch; ii++)
+    { int32_t det=0;
+      lstat[ii]=0;
+      for(int jj=0; jj<bands.getNbands(); jj++)
+        if(bandParameters[jj].thresh>=0)
+        { int32_t bthr = (cfarRate>0)? thr: bandParameters[jj].thresh;
+          det |= ((((int64_t)bandVal[ii][jj])<<8) > bthr*nband[ii][jj]);
+          int32_t ls = mLog2q3(bandVal[ii][jj]) - mLog2q3((uint32_t)(nband[ii][jj]>>8));
+          if(ls>lstat[ii]) lstat[ii]=ls;
+        }
+      ndet += det;
+      if(det) chanMask |= (1<<ii);
+    }
   }
   else
-  {
-    max2Val = 0;
-    avg2Val = 0;
+  { for(int ii=0; ii<nch; ii++)
+    { int32_t det = (maxVal[ii] > (int64_t)thr*nest[ii]);
+      ndet += det;
+      if(det) chanMask |= (1<<ii);
+      lstat[ii] = mLog2q3(maxVal[ii]) - mLog2q3(nest[ii]);
+    }
   }
-  
-  //  done with processing of input data: release input buffers
-  if(inp1) release(inp1);
-  if(inp2) release(inp2);
 
-  int32_t det1 = (max1Val > thresh*nest1);
-  int32_t det2 = (max2Val > thresh*nest2);
+  // event book keeping (peak SNR is taken before sorting)
+  if(sigCount>0)
+  { if(event.duration<0xffff) event.duration++;
+    event.chanMask |= chanMask;
+    for(int ii=0; ii<nch; ii++) if(lstat[ii]>event.snr) event.snr=lstat[ii];
+  }
+
+  if(cfarRate>0)
+  { // statistic of k-of-N vote is the nvote-th largest channel statistic
+    for(int ii=1; ii<nch; ii++)
+    { int32_t ls=lstat[ii]; int jj;
+      for(jj=ii; (jj>0) && (lstat[jj-1]<ls); jj--) lstat[jj]=lstat[jj-1];
+      lstat[jj]=ls;
+    }
+    cfar.add(lstat[nvote-1]);
+    // adapt threshold once per second
+    if(++blockCount >= F_SAMP/AUDIO_BLOCK_SAMPLES)
+    { blockCount=0;
+      thr=cfar.update();
+      if(thr<2) thr=2;
+    }
+  }
 
   // 
   // on detection sigCount will be set to (extr+ndel) and counting down to -inhib
   // if sigCount>0, new detections will reset sigCount to max value (extr+ndel)
   // if sigCount reaches 0, storage will be closed.
   // new detections are only accepted if sigCount gets less than -inhib
+  // (after a noise snippet sigCount goes straight to -inhib)
   //
 
-  if(((sigCount>0) || (sigCount<=-inhib)) && ( det1 || det2)) sigCount=extr+ndel; // retrigger extraction
-  if(sigCount>0) detCount++;
+  int16_t newEvent=0;
+  if(((sigCount>0) || (sigCount<=-inhib)) && (ndet>=nvote))
+  { newEvent = (sigCount<=0);
+    sigCount=extr+ndel; // retrigger extraction
+    noise=0;            // a detection during a noise snippet makes it a detection snippet
+    noiseCount=0;
+  }
+  else if(nrep>0)
+  { // noise only archiving: only while no detection is active and guard window has passed
+    // as detector is ahead of the delayed data, also noise snippet covers ndel blocks before now
+    if(sigCount<=0) noiseCount++;
+    if((noiseCount>=nrep) && (sigCount<=-inhib))
+    { newEvent=1;
+      sigCount=extr+ndel;
+      noise=1;
+      noiseCount=0;
+    }
+  }
+  if(newEvent)
+  { event.time = RTC_TSR;
+    event.block = blockIndex;
+    event.duration = 1;
+    event.chanMask = noise? 0: chanMask;
+    event.snr = 0;
+    for(int ii=0; ii<nch; ii++) if(lstat[ii]>event.snr) event.snr=lstat[ii];
+    for(int ii=0; ii<7; ii++) event.tdoa[ii]=0;
+    event.score=0xffff;
+    if((nch>1) && !noise) tdoa.start(blockIndex);
+  }
+
+  // keep data for TDOA estimation (only copies on trigger)
+  tdoa.capture(inp);
+  //  done with processing of input data: release input buffers
+  for(int ii=0; ii<nch; ii++) if(inp[ii]) release(inp[ii]);
+  if((sigCount>0) && !noise) detCount++; // noise snippets are not detections
 
   // reduce sigCount to a minimal value providing the possibility of a guard window
   // between two detections
   sigCount--; if(sigCount< -inhib) sigCount = -inhib; 
+  blockIndex++;
+
+  if(sigCount==0)
+  { // storage ends: hand event over to loop (drop if loop did not fetch older events)
+    uint16_t h = (evHead+1) % NEVENTS;
+    if(h != evTail)
+    { event.flags = noise? EVENT_FLAG_NOISE: 0;
+      event.file[0] = 0;
+      evQueue[h] = event;
+      evHead = h;
+    }
+    // a noise snippet has no guard window, detections are accepted right away
+    if(noise) sigCount = -inhib;
+  }
 
   // update background noise estimate
   uint32_t winx;
   // change averaging window according to detection status
   if(sigCount<0) winx=win0; else winx=win1;
     
-  nest1=(((int64_t)nest1)*winx+(int64_t)(avg1Val-nest1))/winx;
-  nest2=(((int64_t)nest2)*winx+(int64_t)(avg2Val-nest2))/winx;   
+  uint32_t tmpNoise=0, tmpValue=0;
+  if(nquant>0)
+  { int16_t slow = (sigCount>=0);
+    if(iproc==2)
+    { for(int ii=0; ii<nch; ii++) for(int jj=0; jj<bands.getNbands(); jj++)
+      { lnband[ii][jj]=quant.update(lnband[ii][jj], bandVal[ii][jj], slow);
+        nband[ii][jj]=((int64_t)mExp2q16(lnband[ii][jj]))<<8;
+      }
+    }
+    else
+    { for(int ii=0; ii<nch; ii++)
+      { lnest[ii]=quant.update(lnest[ii], avgVal[ii], slow);
+        nest[ii]=mExp2q16(lnest[ii]);
+      }
+    }
+  }
 
-  // for debugging
-  uint32_t tmp=(nest1>nest2)? nest1:nest2;
-  maxNoise=(tmp>maxNoise)? tmp:maxNoise;
-  
-  tmp=(max1Val>max2Val)? max1Val:max2Val;
-  maxValue=(tmp>maxValue)? tmp:maxValue;
+  if(iproc==2)
+  { for(int ii=0; ii<nch; ii++) for(int jj=0; jj<bands.getNbands(); jj++)
+    { if(nquant<=0) nband[ii][jj]=(nband[ii][jj]*winx+((((int64_t)bandVal[ii][jj])<<8)-nband[ii][jj]))/winx;
+      // for debugging
+      if((uint32_t)(nband[ii][jj]>>8)>tmpNoise) tmpNoise=nband[ii][jj]>>8;
+      if((uint32_t)bandVal[ii][jj]>tmpValue) tmpValue=bandVal[ii][jj];
+    }
+  }
+  else
+  { for(int ii=0; ii<nch; ii++)
+    { if(nquant<=0) nest[ii]=(((int64_t)nest[ii])*winx+(int64_t)(avgVal[ii]-nest[ii]))/winx;
+      // for debugging
+      if((uint32_t)nest[ii]>tmpNoise) tmpNoise=nest[ii];
+      if((uint32_t)maxVal[ii]>tmpValue) tmpValue=maxVal[ii];
+    }
+  }
+  maxNoise=(tmpNoise>maxNoise)? tmpNoise:maxNoise;
+  maxValue=(tmpValue>maxValue)? tmpValue:maxValue;
+
+  uint32_t cyc=ARM_DWT_CYCCNT-cyc0;
+  if(cyc>cycMax) cycMax=cyc;
 }
 
 #endif
@@ -0,0 +1,101 @@
+/* Sound Recorder for Teensy 3.6
+ * Copyright (c) 2018, Walter Zimmer
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef M_BANDS_H
+#define M_BANDS_H
+
+/*
+ * band energy estimator for the detector (iproc == 2) and the classifier features (m_classifier.h)
+ *
+ * one Hann windowed 128 point real FFT (CMSIS-DSP, q15) per audio block and channel
+ * energy is summed over the FFT bins of each configured band
+ *
+ * cost is measured on the device: mProcess::getCycles() (max cycles per block, all channels)
+ * is printed with the debug statistics; the block period is 128/fs, i.e. 256k cycles at 48 kHz
+ * and 96 MHz (128k cycles at 96 kHz)
+ *
+ * src/bandDetector.py runs the same detector on recorded wav files;
+ * test/test_bands.cpp checks it against this code on the host
+ */
+#include "arm_math.h"
+#include "AudioStream.h"
+
+#define NFFT AUDIO_BLOCK_SAMPLES // one FFT per audio block
+
+template <int nmax> // max number of bands
+class mBands
+{
+public:
+  mBands(void) : nb(0) {}
+  void begin(BAND_Parameters_s *bands, int16_t nbands, int32_t fsamp);
+  void process(int16_t *data, int32_t *pow);
+  int16_t getNbands(void) {return nb;}
+
+private:
+  arm_rfft_instance_q15 rfft;
+  int16_t nb;                   // number of bands
+  int16_t ib1[nmax], ib2[nmax]; // first and last FFT bin of each band
+  int16_t window[NFFT];         // Hann window (q15)
+  int16_t buffer[NFFT];         // windowed data
+  int16_t spec[2*NFFT];         // complex spectrum
+};
+
+template <int nmax>
+void mBands<nmax>::begin(BAND_Parameters_s *bands, int16_t nbands, int32_t fsamp)
+{
+  if(nbands>nmax) nbands=nmax;
+  nb=nbands;
+
+  for(int ii=0; ii<NFFT; ii++)
+    window[ii] = (int16_t)(32767.0f*(0.5f - 0.5f*cosf(2.0f*3.1415927f*ii/NFFT)));
+
+  // convert band edges to FFT bins (bin width is fsamp/NFFT)
+  for(int ii=0; ii<nb; ii++)
+  { int32_t i1 = (bands[ii].f1*NFFT)/fsamp;
+    int32_t i2 = (bands[ii].f2*NFFT)/fsamp;
+    if(i1<1) i1=1;              // skip DC
+    if(i2>NFFT/2) i2=NFFT/2;    // up to Nyquist
+    if(i2<i1) i2=i1;
+    ib1[ii]=i1;
+    ib2[ii]=i2;
+  }
+
+  arm_rfft_init_q15(&rfft, NFFT, 0, 1);
+}
+
+template <int nmax>
+void mBands<nmax>::process(int16_t *data, int32_t *pow)
+{
+  arm_mult_q15(data, window, buffer, NFFT);
+  arm_rfft_q15(&rfft, buffer, spec);
+
+  for(int ii=0; ii<nb; ii++)
+  { uint64_t sum=0;
+    for(int jj=ib1[ii]; jj<=ib2[ii]; jj++)
+    { int32_t re=spec[2*jj];
+      int32_t im=spec[2*jj+1];
+      sum += (uint32_t)(re*re) + (uint32_t)(im*im);
+    }
+    pow[ii] = (sum>0x7fffffff)? 0x7fffffff : (int32_t) sum;
+  }
+}
+
+#endif
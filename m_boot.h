@@ -0,0 +1,117 @@
+/* Sound Recorder for Teensy 3.6
+ * Copyright (c) 2018, Walter Zimmer
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef M_BOOT_H
+#define M_BOOT_H
+
+/*
+ * boot-phase profiler
+ *
+ * setup() calls mark(phase) at the end of each phase; the time since the previous mark
+ * (cycle counter, millis() for phases longer than 10 s) is added to that phase.
+ * the record is completed by the first frame in loop() (time to first sample),
+ * appended to "Boot_<name>.bin" (48 bytes, little endian) and printed.
+ * cycles are converted with the core clock passed to mark() (power.getMHz() once CPU_SCALING is active).
+ * with FAST_RESUME loop() starts a record with resume() after each wake-up (no reset, no setup() phases).
+ * src/boot.py summarises the file (mean and max per phase, cold and wake-up boots).
+ */
+#include "core_pins.h"
+
+enum { BOOT_RESET=0,  // reset to setup() (millis() resolution)
+       BOOT_INIT,     // USB serial, audio memory
+       BOOT_SD,       // card mount
+       BOOT_CONFIG,   // Config.txt
+       BOOT_ENVIRO,   // environmental sensors
+       BOOT_MENU,     // menu (only if pin 3 grounded)
+       BOOT_SCHED,    // schedule and duty cycle check (includes sleep with FAST_RESUME)
+       BOOT_ACQ,      // ADC/I2S dividers, codec
+       BOOT_PROC,     // delay, detector, classifier, LTSA, spill file
+       BOOT_FIRST,    // end of setup to first frame in loop
+       BOOT_NPHASE };
+
+#define BOOT_NAMES {"reset","init","sd","config","enviro","menu","sched","acq","proc","first"}
+#define BOOT_WAKEUP 0x01 // RCM_SRS0 wake-up bit, also set by resume()
+
+typedef struct
+{ uint32_t time;            // RTC at setup()
+  uint8_t  reset;           // RCM_SRS0 (0x01: wake-up from VLLS, 0x40: power-on, 0x20: watchdog, 0x04: low voltage)
+  uint8_t  nphase;          // BOOT_NPHASE
+  uint16_t mhz;             // F_CPU in MHz
+  uint32_t us[BOOT_NPHASE]; // duration of each phase in microseconds
+} BOOT_Record_s;
+
+class mBoot
+{
+public:
+  mBoot(void) : done(1) {}
+  void begin(uint32_t tnow, uint8_t reset);
+  void resume(uint32_t tnow) {begin(tnow, BOOT_WAKEUP); rec.us[BOOT_RESET]=0;}
+  void mark(int16_t phase, uint32_t mhz=F_CPU/1000000);
+  int16_t isDone(void) {return done;}
+  void finish(uint32_t mhz) {mark(BOOT_FIRST, mhz); done=1;}
+  BOOT_Record_s *getRecord(void) {return &rec;}
+  void print(void);
+
+private:
+  BOOT_Record_s rec;
+  uint32_t lastCyc, lastMs;
+  int16_t done;
+};
+
+void mBoot::begin(uint32_t tnow, uint8_t reset)
+{
+  ARM_DEMCR |= ARM_DEMCR_TRCENA;
+  ARM_DWT_CTRL |= ARM_DWT_CTRL_CYCCNTENA;
+  memset(&rec, 0, sizeof(rec));
+  rec.time=tnow;
+  rec.reset=reset;
+  rec.nphase=BOOT_NPHASE;
+  rec.mhz=F_CPU/1000000;
+  lastMs=millis();
+  lastCyc=ARM_DWT_CYCCNT;
+  rec.us[BOOT_RESET]=lastMs*1000;
+  done=0;
+}
+
+// mhz: core clock since the previous mark
+void mBoot::mark(int16_t phase, uint32_t mhz)
+{
+  if(done || phase<0 || phase>=BOOT_NPHASE) return;
+  uint32_t cyc=ARM_DWT_CYCCNT, ms=millis();
+  uint32_t dms=ms-lastMs;
+  rec.us[phase] += (dms<10000)? (cyc-lastCyc)/mhz: dms*1000; // cycle counter wraps after 23 s at 180 MHz
+  lastCyc=cyc;
+  lastMs=ms;
+}
+
+void mBoot::print(void)
+{
+  static const char *names[] = BOOT_NAMES;
+  uint32_t total=0;
+  Serial.printf("boot (us, reset 0x%02x):", rec.reset);
+  for(int ii=0; ii<BOOT_NPHASE; ii++)
+  { Serial.printf(" %s %d", names[ii], rec.us[ii]);
+    total += rec.us[ii];
+  }
+  Serial.printf("; total %d\r\n", total);
+}
+
+#endif
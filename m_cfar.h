@@ -0,0 +1,108 @@
+/* Sound Recorder for Teensy 3.6
+ * Copyright (c) 2018, Walter Zimmer
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef M_CFAR_H
+#define M_CFAR_H
+
+/*
+ * constant false alarm rate (CFAR) threshold
+ *
+ * the detector statistic (power SNR) of each block is entered as log2 value
+ * with 3 fractional bits (1/8 octave, 0.375 dB) into a histogram of NHIST bins.
+ * Once per second the threshold is set to the lowest bin for which the fraction of blocks
+ * above the threshold does not exceed the target rate (triggers per hour / blocks per hour).
+ * The histogram is halved whenever it holds more than one hour of blocks,
+ * so it follows the last one to two hours of noise statistics.
+ * Memory is NHIST counters, CPU is one increment per block and one histogram scan per second.
+ */
+
+#define NHIST 160 // 20 octaves, i.e. power SNR up to 60 dB
+
+// log2 of x with 3 fractional bits (no divide, uses CLZ)
+static inline int32_t mLog2q3(uint32_t x)
+{ if(x==0) return 0;
+  int32_t n = 31-__builtin_clz(x);
+  int32_t f = (n>=3)? (x>>(n-3))&7 : (x<<(3-n))&7;
+  return (n<<3) | f;
+}
+
+// inverse of mLog2q3
+static inline int32_t mExp2q3(int32_t lx)
+{ if(lx<0) return 0;
+  int32_t n = lx>>3;
+  return (n>=3)? (8+(lx&7))<<(n-3) : (8+(lx&7))>>(3-n);
+}
+
+class mCfar
+{
+public:
+  mCfar(void) : rate(0) {}
+  void begin(int32_t ratePerHour, uint32_t blocksPerHour, int32_t thr0);
+  void add(int32_t lstat);
+  int32_t update(void);
+  int32_t getThreshold(void) {return thr;}
+
+private:
+  uint32_t hist[NHIST];
+  uint32_t total;
+  uint32_t nblocks;    // blocks per hour
+  int32_t rate;        // target triggers per hour
+  int32_t thr;         // actual threshold (power SNR)
+};
+
+void mCfar::begin(int32_t ratePerHour, uint32_t blocksPerHour, int32_t thr0)
+{
+  rate=ratePerHour;
+  nblocks=blocksPerHour;
+  thr=thr0;
+  for(int ii=0; ii<NHIST; ii++) hist[ii]=0;
+  total=0;
+}
+
+// lstat: detector statistic as log2 with 3 fractional bits (see mLog2q3)
+void mCfar::add(int32_t lstat)
+{
+  if(lstat<0) lstat=0;
+  if(lstat>=NHIST) lstat=NHIST-1;
+  hist[lstat]++;
+  total++;
+  if(total>nblocks)
+  { total=0;
+    for(int ii=0; ii<NHIST; ii++) { hist[ii] >>= 1; total += hist[ii];}
+  }
+}
+
+int32_t mCfar::update(void)
+{
+  if(rate<=0) return thr;
+  // find lowest bin with tail/total <= rate/nblocks
+  uint64_t limit = (uint64_t)total*rate;
+  uint64_t tail=0;
+  int ii;
+  for(ii=NHIST-1; ii>0; ii--)
+  { tail += hist[ii];
+    if(tail*nblocks > limit) break;
+  }
+  thr = mExp2q3(ii+1);
+  return thr;
+}
+
+#endif
@@ -0,0 +1,204 @@
+/* Sound Recorder for Teensy 3.6
+ * Copyright (c) 2018, Walter Zimmer
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef M_CLASSIFIER_H
+#define M_CLASSIFIER_H
+
+/*
+ * second stage classifier (gates storage of detections, see snipParameters.clsf)
+ *
+ * features: log2 energy (3 fractional bits, mLog2q3) of nmel mel spaced bands (m_bands.h)
+ *           of channel 0, summed over bpf blocks per frame, for the first nfrm frames of the stored file
+ *           the mean over all features is subtracted (gain independent) and the result clipped to int8
+ * model:    int8 MLP (up to CLS_MAXLAYER layers, int32 accumulator, power of two rescaling, ReLU)
+ *           class 0 is "other"; score is the probability (percent) of not being class 0
+ *           (a single output is taken as logistic target score)
+ *
+ * features are accumulated in loop() from the data that are written to disk (without the MCDEL look-back),
+ * inference runs once when the file is closed (about 10k MAC for 16x16 features, 32 hidden units).
+ *
+ * model file "Model.bin" (little endian), written by src/classifier.py:
+ *   char magic[4] "MCLS"; uint16 version; uint16 nmel; uint16 nfrm; uint16 bpf; uint16 nlayer; uint16 reserved;
+ *   uint32 fsamp; uint16 bins[nmel+1] (band m covers FFT bins bins[m] .. bins[m+1]-1)
+ *   per layer: uint16 nout; uint16 nin; int16 shift; uint16 relu; int8 W[nout][nin]; int32 b[nout]
+ *   hidden layers: y = clip8(relu((b + W x) >> shift)), 0 <= shift <= 31; last layer: logit = (b + W x) / 2^shift
+ *
+ * needs USE_CLASSIFIER in config.h (the object takes about 22 kB of RAM);
+ * test/test_classifier.cpp runs this code on the host and compares it with src/classifier.py
+ */
+#include "m_bands.h"
+#include "m_cfar.h" // mLog2q3
+
+#define CLS_MAXMEL 32
+#define CLS_MAXFRM 32
+#define CLS_MAXIN (CLS_MAXMEL*CLS_MAXFRM)
+#define CLS_MAXHID 128
+#define CLS_MAXLAYER 4
+#define CLS_MAXMODEL 16384 // bytes
+#define CLS_VERSION 1
+
+typedef struct
+{ uint16_t nout, nin;
+  int16_t shift, relu;
+  int8_t *W;
+  uint8_t *b; // int32, not necessarily aligned
+} CLS_Layer_s;
+
+class mClassifier
+{
+public:
+  mClassifier(void) : valid(0) {}
+  uint8_t *getBuffer(void) {return model;}
+  int16_t begin(int32_t nbytes, int32_t fsamp);
+  int16_t isValid(void) {return valid;}
+  void reset(void);
+  void addBlock(int16_t *data, int16_t stride);
+  int16_t score(void);
+
+private:
+  uint8_t model[CLS_MAXMODEL];
+  int16_t valid;
+  int16_t nmel, nfrm, bpf, nlayer;
+  CLS_Layer_s layer[CLS_MAXLAYER];
+  mBands<CLS_MAXMEL> bands;
+  int32_t nblk;                         // blocks accumulated since reset
+  uint32_t acc[CLS_MAXFRM][CLS_MAXMEL]; // band energies per frame
+  int16_t buffer[AUDIO_BLOCK_SAMPLES];
+  int32_t pow[CLS_MAXMEL];
+  int8_t x0[CLS_MAXIN], x1[CLS_MAXHID];
+};
+
+static inline uint16_t clsU16(uint8_t *p) { return p[0] | (p[1]<<8);}
+static inline int32_t clsI32(uint8_t *p) { return (int32_t)(p[0] | (p[1]<<8) | (p[2]<<16) | ((uint32_t)p[3]<<24));}
+
+int16_t mClassifier::begin(int32_t nbytes, int32_t fsamp)
+{
+  valid=0;
+  if(nbytes<20 || strncmp((char *)model, "MCLS", 4)) return 0;
+  if(clsU16(model+4)!=CLS_VERSION) return 0;
+  nmel=clsU16(model+6);
+  nfrm=clsU16(model+8);
+  bpf=clsU16(model+10);
+  nlayer=clsU16(model+12);
+  if((uint32_t)clsI32(model+16)!=(uint32_t)fsamp) return 0; // model trained for other sampling frequency
+  if(nmel<1 || nmel>CLS_MAXMEL || nfrm<1 || nfrm>CLS_MAXFRM || bpf<1 || nlayer<1 || nlayer>CLS_MAXLAYER) return 0;
+
+  uint8_t *ptr = model+20;
+  BAND_Parameters_s mel[CLS_MAXMEL];
+  for(int ii=0; ii<nmel; ii++)
+  { // bin edges to frequencies (rounded up, so that mBands gets the same bins back)
+    int32_t b1=clsU16(ptr+2*ii), b2=clsU16(ptr+2*ii+2)-1;
+    mel[ii].f1=(b1*fsamp+NFFT-1)/NFFT;
+    mel[ii].f2=(b2*fsamp+NFFT-1)/NFFT;
+    mel[ii].thresh=0;
+  }
+  ptr += 2*(nmel+1);
+
+  int32_t nin=nmel*nfrm;
+  for(int ii=0; ii<nlayer; ii++)
+  { if(ptr+8>model+nbytes) return 0;
+    layer[ii].nout=clsU16(ptr);
+    layer[ii].nin=clsU16(ptr+2);
+    layer[ii].shift=(int16_t)clsU16(ptr+4);
+    layer[ii].relu=clsU16(ptr+6);
+    ptr += 8;
+    if((ii<nlayer-1) && (layer[ii].shift<0 || layer[ii].shift>31)) return 0; // hidden layers: right shift of int32
+    if(layer[ii].nin!=nin) return 0;
+    if(layer[ii].nout<1 || (ii<nlayer-1 && layer[ii].nout>CLS_MAXHID)) return 0;
+    layer[ii].W=(int8_t *)ptr; ptr += layer[ii].nout*layer[ii].nin;
+    layer[ii].b=ptr;          ptr += 4*layer[ii].nout;
+    if(ptr>model+nbytes) return 0;
+    nin=layer[ii].nout;
+  }
+
+  bands.begin(mel, nmel, fsamp);
+  reset();
+  valid=1;
+  return valid;
+}
+
+void mClassifier::reset(void)
+{ nblk=0;
+  memset(acc, 0, sizeof(acc));
+}
+
+// data: interleaved audio block (stride: number of channels), only channel 0 is used
+void mClassifier::addBlock(int16_t *data, int16_t stride)
+{
+  if(!valid || nblk>=nfrm*bpf) return;
+  for(int ii=0; ii<AUDIO_BLOCK_SAMPLES; ii++) buffer[ii]=data[ii*stride];
+  bands.process(buffer, pow);
+  uint32_t *frm=acc[nblk/bpf];
+  for(int ii=0; ii<nmel; ii++)
+  { uint32_t sum=frm[ii]+(uint32_t)pow[ii];
+    frm[ii] = (sum<frm[ii])? 0xffffffff : sum;
+  }
+  nblk++;
+}
+
+// probability (percent) of not being class 0; -1 if no model
+int16_t mClassifier::score(void)
+{
+  if(!valid) return -1;
+  int32_t nin=nmel*nfrm;
+  int32_t mean=0;
+  for(int ii=0; ii<nfrm; ii++) for(int jj=0; jj<nmel; jj++) mean += mLog2q3(acc[ii][jj]);
+  mean /= nin;
+  for(int ii=0; ii<nfrm; ii++) for(int jj=0; jj<nmel; jj++)
+  { int32_t v=mLog2q3(acc[ii][jj])-mean;
+    x0[ii*nmel+jj] = (v<-128)? -128: (v>127)? 127: v;
+  }
+
+  int8_t *x=x0, *y=x1;
+  float logit[CLS_MAXHID];
+  for(int ll=0; ll<nlayer; ll++)
+  { CLS_Layer_s *L=&layer[ll];
+    int8_t *W=L->W;
+    for(int oo=0; oo<L->nout; oo++)
+    { int32_t sum=clsI32(L->b+4*oo);
+      for(int ii=0; ii<L->nin; ii++) sum += (*W++)*x[ii];
+      if(ll<nlayer-1)
+      { sum >>= L->shift;
+        if(L->relu && sum<0) sum=0;
+        y[oo] = (sum<-128)? -128: (sum>127)? 127: sum;
+      }
+      else if(oo<CLS_MAXHID)
+        logit[oo] = ldexpf((float)sum, -L->shift);
+    }
+    int8_t *t=x; x=y; y=t;
+  }
+
+  int16_t nout=layer[nlayer-1].nout;
+  if(nout>CLS_MAXHID) nout=CLS_MAXHID;
+  float p;
+  if(nout==1)
+    p = 1.0f/(1.0f+expf(-logit[0]));
+  else
+  { float lmax=logit[0];
+    for(int ii=1; ii<nout; ii++) if(logit[ii]>lmax) lmax=logit[ii];
+    float sum=0.0f;
+    for(int ii=0; ii<nout; ii++) sum += expf(logit[ii]-lmax);
+    p = 1.0f-expf(logit[0]-lmax)/sum;
+  }
+  return (int16_t)(100.0f*p+0.5f);
+}
+
+#endif
@@ -0,0 +1,149 @@
+/* Sound Recorder for Teensy 3.6
+ * Copyright (c) 2018, Walter Zimmer
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef M_CONFIG_H
+#define M_CONFIG_H
+
+/*
+ * configuration store "Config.txt" (see c_uSD::loadConfig/storeConfig)
+ *
+ * key=value lines, one per field of ACQ_Parameters_s and SNIP_Parameters_s (schema cfgItem), e.g.
+ *   version=2
+ *   on=300
+ *   ...
+ *   name=WMXZ
+ *   crc=1D0F          CRC-16/CCITT-FALSE (m_proto.h) of all bytes before this line, hex
+ * the file is read with one read at boot and accepted only as a whole: a wrong crc, a value out of range,
+ * an unparsable line or (for hand edited files without crc line) a missing key reject the file
+ * and the compiled defaults are used; unknown keys (newer versions) are ignored.
+ * files of the previous format (fixed 12 byte numbers, no "version=") are read once and rewritten
+ * (test/test_config.cpp).
+ */
+#include "m_proto.h"
+
+#define CFG_VERSION 2
+#define CFG_MAXTEXT 1024
+#define MAX_VAL 1<<17 // as m_menu.h
+
+typedef struct
+{ const char *key;
+  uint8_t snip;   // 0: ACQ_Parameters_s, 1: SNIP_Parameters_s
+  uint8_t index;  // 32 bit word in structure
+  int32_t vmin, vmax; // vmin > vmax: not checked
+} CFG_Item_s;
+
+// ndel: without detector (MDEL<0) the compiled default is MDEL
+static const CFG_Item_s cfgItem[] = {
+  {"on", 0, 0, 0, MAX_VAL}, {"ad", 0, 1, 0, MAX_VAL}, {"ar", 0, 2, 0, MAX_VAL},
+  {"T1", 0, 3, 0, 24}, {"T2", 0, 4, 0, 24}, {"T3", 0, 5, 0, 24}, {"T4", 0, 6, 0, 24},
+  {"rec", 0, 7, 1, 0},
+  {"iproc", 1, 0, 0, 2}, {"thresh", 1, 1, -1, MAX_VAL}, {"win0", 1, 2, 0, MAX_VAL}, {"win1", 1, 3, 0, MAX_VAL},
+  {"extr", 1, 4, 0, MAX_VAL}, {"inhib", 1, 5, 0, MAX_VAL}, {"nrep", 1, 6, 0, MAX_VAL},
+  {"ndel", 1, 7, (MDEL<0)? MDEL: 0, NDEL_MAX}, {"nvote", 1, 8, 1, NCH}, {"cfar", 1, 9, 0, MAX_VAL},
+  {"nquant", 1, 10, 0, 99}, {"clsf", 1, 11, 0, 100}, {"ltsa", 1, 12, 0, 3600}
+};
+#define CFG_NITEM (sizeof(cfgItem)/sizeof(CFG_Item_s))
+static_assert(CFG_NITEM == 8+N_SNIP_PARAMETERS, "config schema does not match parameter structures");
+
+static int32_t *cfgValue(const CFG_Item_s *item, ACQ_Parameters_s *acq, SNIP_Parameters_s *snip)
+{ return (item->snip? (int32_t *)snip: (int32_t *)acq) + item->index;
+}
+
+// previous format: "%10d\r\n" fields (8 acq values, then snip values in schema order), then name;
+// older firmware wrote fewer snip values (8 in the first format), the missing ones keep their defaults
+static int16_t cfgParseLegacy(char *text, int32_t nbytes, ACQ_Parameters_s *acq, SNIP_Parameters_s *snip)
+{
+  uint16_t nval=0;
+  while(nval<CFG_NITEM && 12*(nval+1)<=nbytes && text[12*nval+10]=='\r' && text[12*nval+11]=='\n')
+  { int v;
+    char c;
+    if(sscanf(text+12*nval, "%d%c", &v, &c)!=2 || c!='\r') break; // name field
+    *cfgValue(&cfgItem[nval], acq, snip)=v;
+    nval++;
+  }
+  if(nval<8) return 0;
+  char name[8];
+  if(sscanf(text+12*nval, "%7s", name)!=1) return 0;
+  strcpy(acq->name, name);
+  return 1;
+}
+
+// parse text (nul terminated) into acq and snip; only changes them if the whole text is valid
+// returns 1 on success, 2 for previous format; 0 and *err on rejection
+static int16_t cfgParse(char *text, int32_t nbytes, ACQ_Parameters_s *acq, SNIP_Parameters_s *snip, const char **err)
+{
+  ACQ_Parameters_s a=*acq;
+  SNIP_Parameters_s s=*snip;
+  if(!strstr(text, "version="))
+  { if(!cfgParseLegacy(text, nbytes, &a, &s)) { *err="unknown format"; return 0;}
+    *acq=a; *snip=s;
+    return 2;
+  }
+  char *crcLine=strstr(text, "crc=");
+  if(crcLine)
+  { if(protoCrc((uint8_t *)text, crcLine-text) != strtoul(crcLine+4, 0, 16)) { *err="crc mismatch"; return 0;}
+    *crcLine=0; // end of data
+  }
+  uint32_t seen=0;
+  int16_t haveName=0;
+  char *line=strtok(text, "\r\n");
+  for( ; line; line=strtok(0, "\r\n"))
+  { if(!line[0] || line[0]=='#') continue;
+    char *val=strchr(line, '=');
+    if(!val) { *err="line without '='"; return 0;}
+    *val++=0;
+    if(!strcmp(line, "version")) continue;
+    if(!strcmp(line, "name"))
+    { if(!val[0] || strlen(val)>=sizeof(a.name)) { *err="bad name"; return 0;}
+      strcpy(a.name, val);
+      haveName=1;
+      continue;
+    }
+    uint16_t ii;
+    for(ii=0; ii<CFG_NITEM && strcmp(line, cfgItem[ii].key); ii++) ;
+    if(ii==CFG_NITEM) continue; // unknown key of newer version
+    char *end;
+    int32_t v = cfgItem[ii].snip? strtol(val, &end, 10): (int32_t)strtoul(val, &end, 10);
+    if(end==val || *end) { *err="bad number"; return 0;}
+    if(cfgItem[ii].vmin<=cfgItem[ii].vmax && (v<cfgItem[ii].vmin || v>cfgItem[ii].vmax)) { *err="value out of range"; return 0;}
+    *cfgValue(&cfgItem[ii], &a, &s)=v;
+    seen |= 1<<ii;
+  }
+  if(!crcLine && (!haveName || seen != (1u<<CFG_NITEM)-1)) { *err="missing keys (and no crc)"; return 0;}
+  *acq=a; *snip=s;
+  return 1;
+}
+
+// returns number of bytes written to text (including crc line)
+static int32_t cfgFormat(char *text, int32_t nmax, ACQ_Parameters_s *acq, SNIP_Parameters_s *snip)
+{
+  int32_t n=snprintf(text, nmax, "version=%d\r\n", CFG_VERSION);
+  for(uint16_t ii=0; ii<CFG_NITEM; ii++)
+  { int32_t v=*cfgValue(&cfgItem[ii], acq, snip);
+    if(cfgItem[ii].snip) n+=snprintf(text+n, nmax-n, "%s=%d\r\n", cfgItem[ii].key, (int)v);
+    else                 n+=snprintf(text+n, nmax-n, "%s=%u\r\n", cfgItem[ii].key, (unsigned)v);
+  }
+  n+=snprintf(text+n, nmax-n, "name=%s\r\n", acq->name);
+  n+=snprintf(text+n, nmax-n, "crc=%04X\r\n", protoCrc((uint8_t *)text, n));
+  return n;
+}
+
+#endif
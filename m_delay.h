@@ -23,40 +23,58 @@
 #ifndef M_DELAY_H
 #define M_DELAY_H
 
+#include <stdlib.h>
 #include "AudioStream.h"
 
-template <int nch, int mq>
+// WMXZ delay line for all channels
+// ring of frames (one block per channel) is allocated once at boot from the loaded pre-trigger length,
+// a pre-trigger changed in the menu takes effect at the next boot
+// update() writes and reads one frame without modulo
+template <int nch>
 class mDelay : public AudioStream
 {
 public:
-
-  mDelay(int del) : AudioStream(nch, inputQueueArray), head(mq), numDelay(del){ reset(); }
-  void reset(void);
-  void setDelay(int16_t ndel) {numDelay=ndel;}
+  mDelay(void) : AudioStream(nch, inputQueueArray), maxCount(0), ring(NULL), mq(0), head(0), tail(0), count(0) { }
+  int16_t begin(uint16_t ndel);
+  uint16_t getDelay(void) {return numDelay;}
+  uint16_t capacity(void) {return mq? mq-1: 0;}
   virtual void update(void);
+  volatile uint16_t maxCount; // high-water mark of blocks held (reset by user)
   
 protected:  
   audio_block_t *inputQueueArray[nch];
 
 private:
-  audio_block_t * volatile queue[nch][mq];
-  volatile uint16_t head, numDelay;
-
+  audio_block_t ** volatile ring; // mq frames of nch blocks
+  uint16_t mq;
+  volatile uint16_t head, tail, numDelay; // write and read frame
+  uint16_t count; // blocks held
 };
 
-template <int nch, int mq>
-void mDelay<nch,mq>::reset(void)
+// allocate ring for a delay of ndel blocks (once, before data flow matters); returns 0 on failure
+template <int nch>
+int16_t mDelay<nch>::begin(uint16_t ndel)
 {
-  for(int ii=0; ii<nch; ii++) for (int jj=0; jj<mq; jj++) queue[ii][jj]=NULL;
-  head=mq;
+  if(ring) return ndel==numDelay; // ring is not resized
+  audio_block_t **buf = (audio_block_t **) malloc((ndel+1)*nch*sizeof(audio_block_t *));
+  if(!buf) return 0;
+  for(int ii=0; ii<(ndel+1)*nch; ii++) buf[ii]=NULL;
+  __disable_irq();
+  mq=ndel+1;
+  head=0;
+  numDelay=ndel;
+  tail=(mq-ndel)%mq; // frame written ndel updates before head
+  ring=buf;
+  __enable_irq();
+  return 1;
 }
 
-template <int nch, int mq>
-void mDelay<nch,mq>::update(void)
+template <int nch>
+void mDelay<nch>::update(void)
 {
   audio_block_t *block;
 
-  if((numDelay<=0) || (numDelay >= mq)) // bypass queue
+  if(!ring) // bypass until ring is allocated
   {
     for(int ii=0;ii<nch;ii++)
     {
@@ -71,30 +89,27 @@ void mDelay<nch,mq>::update(void)
   }
   //
   
-  uint16_t h = (head + 1) % mq;
+  audio_block_t **frame = ring+head*nch;
   for(int ii=0;ii<nch;ii++)
   {
-    if(queue[ii][h]) release(queue[ii][h]);
-    block = receiveReadOnly(ii);
-    if(block)
-    {
-      queue[ii][h]=block;
-    }
-    else
-      queue[ii][h]=NULL;
+    frame[ii] = receiveReadOnly(ii);
+    if(frame[ii]) count++;
   }
-  head = h;
+  if(count>maxCount) maxCount=count;
+  if(++head>=mq) head=0;
 
-  uint16_t index = ((head  + mq) - numDelay) % mq;
+  frame = ring+tail*nch;
   for(int ii=0;ii<nch;ii++)
   {
-    if(queue[ii][index])
+    if(frame[ii])
     {
-      transmit(queue[ii][index],ii);
-      release(queue[ii][index]);
-      queue[ii][index]=NULL;
+      transmit(frame[ii],ii);
+      release(frame[ii]);
+      frame[ii]=NULL;
+      count--;
     }
   }
+  if(++tail>=mq) tail=0;
 }
 
 #endif
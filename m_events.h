@@ -0,0 +1,74 @@
+/* Sound Recorder for Teensy 3.6
+ * Copyright (c) 2018, Walter Zimmer
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef M_EVENTS_H
+#define M_EVENTS_H
+
+/*
+ * event index file
+ *
+ * one fixed size record (64 bytes, little endian) per trigger is appended to "Events_<name>.bin"
+ * records are collected in RAM and written only between files (see loop in myAPP.cpp)
+ * src/eventIndex.py loads the event files of many recorders into one sorted index
+ */
+
+#define EVENT_FLAG_NOISE 1 // noise only snippet (see nrep)
+#define EVENT_FLAG_REJECT 2 // file removed by classifier (see clsf)
+
+typedef struct
+{ uint32_t time;      // trigger time (RTC seconds since 1970)
+  uint32_t block;     // trigger block index (audio blocks since start of detector)
+  uint16_t duration;  // number of stored blocks
+  uint16_t chanMask;  // channels that detected (bit 0: channel 0)
+  int16_t  snr;       // peak power SNR (log2 with 3 fractional bits: 8 == 3 dB)
+  uint16_t flags;     // EVENT_FLAG_xxx
+  char file[32];      // name of file holding the event (first file if storage was split by size or duty cycle)
+  int16_t  tdoa[7];   // delay of channel 1..7 relative to channel 0 (1/16 samples, see m_tdoa.h)
+  uint16_t score;     // classifier score (percent, see m_classifier.h; 0xffff: not classified)
+} EVENT_Record_s;
+
+#define NEVENTS 8 // number of records kept in RAM before writing to disk
+
+class mEventLog
+{
+public:
+  mEventLog(void) : nrec(0), tlast(0) {}
+  int16_t add(EVENT_Record_s *rec)
+  { if(nrec>=NEVENTS) return 0; // full: record is lost
+    buffer[nrec++] = *rec;
+    return 1;
+  }
+  // write when buffer is full or oldest record is older than 'age' seconds
+  int16_t mustFlush(uint32_t tnow, uint32_t age)
+  { if(nrec==0) { tlast=tnow; return 0;}
+    return (nrec>=NEVENTS) || (tnow > tlast+age);
+  }
+  void *getData(void) {return buffer;}
+  int32_t getSize(void) {return nrec*sizeof(EVENT_Record_s);}
+  void reset(uint32_t tnow) {nrec=0; tlast=tnow;}
+
+private:
+  EVENT_Record_s buffer[NEVENTS];
+  int16_t nrec;
+  uint32_t tlast;
+};
+
+#endif
@@ -0,0 +1,137 @@
+/* Sound Recorder for Teensy 3.6
+ * Copyright (c) 2018, Walter Zimmer
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef M_LOOKBACK_H
+#define M_LOOKBACK_H
+
+/*
+ * compressed pre-trigger look-back (see MCDEL in config.h)
+ *
+ * loop() pushes every multiplexed block that is NOT stored into a ring of IMA-ADPCM coded blocks
+ * (4 bit per sample, 4x less memory than audio blocks); when a file is opened
+ * the ring is decoded (oldest first) and written in front of the first stored block,
+ * so the file starts up to MCDEL bytes worth of history before the (lossless) ndel pre-trigger.
+ * loop() writes LOOK_COPY decoded blocks per pass; the first live block is held and live frames
+ * wait in the audio queue until the ring is empty.
+ * The look-back part is lossy (4 bit ADPCM: about 14 dB SNR for white noise, 25..40 dB for tones,
+ * see test/test_lookback.cpp).
+ *
+ * each channel of a block is coded independently: int16 start sample, uint8 step index, uint8 0,
+ * followed by AUDIO_BLOCK_SAMPLES/2 bytes (low nibble first), i.e. 68 bytes per channel and block
+ */
+#include "AudioStream.h"
+
+#define LB_CHBYTES (4+AUDIO_BLOCK_SAMPLES/2)
+#ifndef LOOK_COPY
+  #define LOOK_COPY 4 // blocks written per loop pass while the ring is drained
+#endif
+
+static const int16_t imaStep[89] = {
+  7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+  50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190, 209, 230, 253, 279, 307,
+  337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066,
+  2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899,
+  15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767};
+static const int8_t imaIndex[16] = {-1, -1, -1, -1, 2, 4, 6, 8, -1, -1, -1, -1, 2, 4, 6, 8};
+
+// reconstruct next sample from code (shared by encoder and decoder)
+static inline int32_t imaStepSample(int32_t pred, int16_t *index, uint8_t code)
+{
+  int32_t step = imaStep[*index];
+  int32_t delta = step>>3;
+  if(code & 4) delta += step;
+  if(code & 2) delta += step>>1;
+  if(code & 1) delta += step>>2;
+  pred += (code & 8)? -delta: delta;
+  if(pred>32767) pred=32767;
+  if(pred<-32768) pred=-32768;
+  *index += imaIndex[code];
+  if(*index<0) *index=0;
+  if(*index>88) *index=88;
+  return pred;
+}
+
+// code one block of one channel (data with stride), index is carried from block to block
+static void imaEncode(int16_t *data, int16_t stride, int16_t *index, uint8_t *out)
+{
+  int32_t pred = data[0];
+  out[0] = pred & 0xff; out[1] = (pred>>8) & 0xff; out[2] = *index; out[3] = 0;
+  out += 4;
+  for(int ii=0; ii<AUDIO_BLOCK_SAMPLES; ii++)
+  { int32_t diff = data[ii*stride] - pred;
+    int32_t step = imaStep[*index];
+    uint8_t code = 0;
+    if(diff<0) { code=8; diff=-diff;}
+    if(diff>=step) { code|=4; diff-=step;}
+    step>>=1;
+    if(diff>=step) { code|=2; diff-=step;}
+    step>>=1;
+    if(diff>=step) code|=1;
+    pred = imaStepSample(pred, index, code);
+    if(ii&1) out[ii>>1] |= code<<4; else out[ii>>1] = code;
+  }
+}
+
+static void imaDecode(uint8_t *inp, int16_t *data, int16_t stride)
+{
+  int32_t pred = (int16_t)(inp[0] | (inp[1]<<8));
+  int16_t index = inp[2];
+  inp += 4;
+  for(int ii=0; ii<AUDIO_BLOCK_SAMPLES; ii++)
+  { uint8_t code = (ii&1)? (inp[ii>>1]>>4): (inp[ii>>1] & 0xf);
+    pred = imaStepSample(pred, &index, code);
+    data[ii*stride] = pred;
+  }
+}
+
+template <int nch, int nbytes>
+class mLookBack
+{
+public:
+  mLookBack(void) : head(0), count(0) { for(int ii=0; ii<nch; ii++) index[ii]=0; }
+  // data are multiplexed blocks (nch*AUDIO_BLOCK_SAMPLES)
+  void push(int16_t *data)
+  { uint8_t *slot = arena + head*nch*LB_CHBYTES;
+    for(int ii=0; ii<nch; ii++) imaEncode(data+ii, nch, &index[ii], slot+ii*LB_CHBYTES);
+    if(++head>=NSLOT) head=0;
+    if(count<NSLOT) count++;
+  }
+  // oldest block first; returns 0 if ring is empty
+  int16_t pop(int16_t *data)
+  { if(!count) return 0;
+    uint16_t tail = (head + NSLOT - count) % NSLOT;
+    uint8_t *slot = arena + tail*nch*LB_CHBYTES;
+    for(int ii=0; ii<nch; ii++) imaDecode(slot+ii*LB_CHBYTES, data+ii, nch);
+    count--;
+    return 1;
+  }
+  uint16_t available(void) {return count;}
+  void clear(void) {count=0;}
+  static uint16_t capacity(void) {return NSLOT;} // in blocks
+
+private:
+  static const uint16_t NSLOT = nbytes/(nch*LB_CHBYTES);
+  uint8_t arena[NSLOT*nch*LB_CHBYTES];
+  uint16_t head, count;
+  int16_t index[nch];
+};
+
+#endif
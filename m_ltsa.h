@@ -0,0 +1,123 @@
+/* Sound Recorder for Teensy 3.6
+ * Copyright (c) 2018, Walter Zimmer
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef M_LTSA_H
+#define M_LTSA_H
+
+/*
+ * long-term spectral average (LTSA)
+ *
+ * loop() hands every audio block (stored or not) to add(); every LTSA_STEP-th block of channel 0
+ * is transformed (mBands with one band per FFT bin) and the power is averaged over snipParameters.ltsa seconds
+ * one record (72 bytes, little endian) per interval is appended to "LTSA_<name>.bin":
+ * 64 bins (fsamp/128 wide, bin 1 to Nyquist) as log2 of mean power with 3 fractional bits (0.375 dB)
+ * i.e. 10 s averages need about 620 kB per day
+ * cost is one mBands call per transformed block (see m_bands.h)
+ *
+ * src/ltsa.py converts the files into a spectrogram overview
+ */
+#include "m_bands.h"
+#include "m_cfar.h" // mLog2q3
+
+#define LTSA_NBIN (AUDIO_BLOCK_SAMPLES/2)
+#ifndef LTSA_STEP
+  #define LTSA_STEP 1 // transform every LTSA_STEP-th block (>1 reduces CPU load)
+#endif
+#define NLTSA 56 // records kept in RAM before writing to disk (about 4 kB)
+
+typedef struct
+{ uint32_t time;             // start of interval (RTC seconds since 1970)
+  uint16_t nblk;             // number of transformed blocks
+  uint8_t  nbin;             // number of spectral bins (LTSA_NBIN)
+  uint8_t  step;             // LTSA_STEP
+  uint8_t  pow[LTSA_NBIN];   // log2 of mean power (3 fractional bits) of bins 1 .. LTSA_NBIN
+} LTSA_Record_s;
+
+class mLtsa
+{
+public:
+  mLtsa(void) : nint(0), nrec(0) {}
+  void begin(int32_t nsec, int32_t fsamp);
+  void add(int16_t *data, int16_t stride, uint32_t tnow);
+  int16_t mustFlush(void) {return nrec>=NLTSA;}
+  void *getData(void) {return buffer;}
+  int32_t getSize(void) {return nrec*sizeof(LTSA_Record_s);}
+  void reset(void) {nrec=0;}
+
+private:
+  mBands<LTSA_NBIN> bands;
+  uint32_t nint;           // blocks per interval (0: disabled)
+  uint32_t count;          // blocks since start of interval
+  uint32_t tstart;
+  uint64_t acc[LTSA_NBIN];
+  int32_t pow[LTSA_NBIN];
+  int16_t buf[AUDIO_BLOCK_SAMPLES];
+  LTSA_Record_s buffer[NLTSA];
+  int16_t nrec;
+};
+
+void mLtsa::begin(int32_t nsec, int32_t fsamp)
+{
+  nint = (nsec>0)? ((uint64_t)nsec*fsamp)/AUDIO_BLOCK_SAMPLES: 0;
+  if(!nint) return;
+  BAND_Parameters_s bin[LTSA_NBIN];
+  for(int ii=0; ii<LTSA_NBIN; ii++)
+  { // single FFT bin per band (rounded up, so that mBands gets the same bin back)
+    bin[ii].f1 = bin[ii].f2 = ((ii+1)*fsamp+NFFT-1)/NFFT;
+    bin[ii].thresh=0;
+  }
+  bands.begin(bin, LTSA_NBIN, fsamp);
+  count=0;
+  nrec=0;
+  for(int ii=0; ii<LTSA_NBIN; ii++) acc[ii]=0;
+}
+
+// data: interleaved audio block (stride: number of channels), only channel 0 is used
+void mLtsa::add(int16_t *data, int16_t stride, uint32_t tnow)
+{
+  if(!nint) return;
+  if(count==0) tstart=tnow;
+  if((count % LTSA_STEP)==0)
+  { for(int ii=0; ii<AUDIO_BLOCK_SAMPLES; ii++) buf[ii]=data[ii*stride];
+    bands.process(buf, pow);
+    for(int ii=0; ii<LTSA_NBIN; ii++) acc[ii] += pow[ii];
+  }
+  if(++count < nint) return;
+
+  // end of interval: store record (drop if buffer was not written)
+  if(nrec<NLTSA)
+  { LTSA_Record_s *rec = &buffer[nrec++];
+    uint32_t nblk = (count+LTSA_STEP-1)/LTSA_STEP;
+    rec->time=tstart;
+    rec->nblk=(nblk>0xffff)? 0xffff: nblk;
+    rec->nbin=LTSA_NBIN;
+    rec->step=LTSA_STEP;
+    for(int ii=0; ii<LTSA_NBIN; ii++)
+    { uint64_t avg = acc[ii]/nblk;
+      int32_t lp = mLog2q3((avg>0xffffffff)? 0xffffffff: (uint32_t)avg);
+      rec->pow[ii] = (lp>255)? 255: lp;
+    }
+  }
+  count=0;
+  for(int ii=0; ii<LTSA_NBIN; ii++) acc[ii]=0;
+}
+
+#endif
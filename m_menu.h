@@ -48,6 +48,7 @@ typedef struct
 
 
 #include <TimeLib.h>
+#include "m_proto.h"
 
 static char * getDate(char *text)
 {
@@ -113,6 +114,11 @@ static void setTime(uint16_t hour, uint16_t minutes, uint16_t seconds)
 ? i\n:  inhib;      // guard window (inhibit follow-on secondary detections)
 ? k\n:  nrep;       // noise only interval (nrep =0  indicates no noise archiving)
 ? p\n:  ndel;       // pre-trigger delay 
+? v\n:  nvote;      // number of channels that must detect
+? f\n:  cfar;       // target trigger rate per hour (0: fixed threshold)
+? q\n:  nquant;     // noise percentile (0: exponential average)
+? g\n:  clsf;       // classifier gate (0: off; min score in percent)
+? l\n:  ltsa;       // LTSA interval in seconds (0: off)
 */
 char text[32]; // neded for text operations
 
@@ -142,17 +148,23 @@ static void printAll(void)
   Serial.printf("%c %5d inhibit window\r\n",        'i',snipParameters.inhib);
   Serial.printf("%c %5d noise repetition rate\r\n", 'k',snipParameters.nrep);
   Serial.printf("%c %5d pre trigger delay\r\n",     'p',snipParameters.ndel);
+  Serial.printf("%c %5d channel vote\r\n",          'v',snipParameters.nvote);
+  Serial.printf("%c %5d triggers per hour (CFAR)\r\n",'f',snipParameters.cfar);
+  Serial.printf("%c %5d noise percentile\r\n",      'q',snipParameters.nquant);
+  Serial.printf("%c %5d classifier gate (%%)\r\n",   'g',snipParameters.clsf);
   #endif
+  Serial.printf("%c %5d LTSA interval (s)\r\n",     'l',snipParameters.ltsa);
   //
   Serial.println();
   Serial.println("exter 'a' to print this");
-  Serial.println("exter '?c' to read value c=(o,a,r,1,2,3,4,n,d,t,c,h,w,s,m,i,k,p)");
+  Serial.println("exter '?c' to read value c=(o,a,r,1,2,3,4,n,d,t,c,h,w,s,m,i,k,p,v,f,q,g,l)");
   Serial.println("  e.g.: ?1 will print first hour");
-  Serial.println("exter '!cval' to read value c=(0,a,r,1,2,3,4,n,d,t,c,h,w,s,m,i,k,p) and val is new value");
+  Serial.println("exter '!cval' to read value c=(0,a,r,1,2,3,4,n,d,t,c,h,w,s,m,i,k,p,v,f,q,g,l) and val is new value");
   Serial.println("  e.g.: !110 will set first hour to 10");
   Serial.println("exter 'xval' to exit menu (x is delay in minutes, -1 means immediate)");
   Serial.println("  e.g.: x10 will exit and hibernate for 10 minutes");
   Serial.println("        x-1 with exit and start immediately");
+  Serial.println("binary frames (0xA5 0x5A ...) for provisioning and data offload: see m_proto.h, src/provision.py and src/offload.py");
   Serial.println();
 }
 
@@ -161,7 +173,7 @@ static void doMenu1(void)
     while(!Serial.available());
     char c=Serial.read();
     
-    if (strchr("oar1234ndtchwseikp", c))
+    if (strchr("oar1234ndtchwseikpvfqgl", c))
     { switch (c)
       {
         case 'o': Serial.printf("%02d\r\n",acqParameters.on); break;
@@ -184,7 +196,12 @@ static void doMenu1(void)
         case 'i': Serial.printf("%04d\r\n",snipParameters.inhib);break;
         case 'k': Serial.printf("%04d\r\n",snipParameters.nrep);break;
         case 'p': Serial.printf("%04d\r\n",snipParameters.ndel);break;
+        case 'v': Serial.printf("%04d\r\n",snipParameters.nvote);break;
+        case 'f': Serial.printf("%04d\r\n",snipParameters.cfar);break;
+        case 'q': Serial.printf("%04d\r\n",snipParameters.nquant);break;
+        case 'g': Serial.printf("%04d\r\n",snipParameters.clsf);break;
         #endif
+        case 'l': Serial.printf("%04d\r\n",snipParameters.ltsa);break;
         default: break;
       }
     }
@@ -244,6 +261,11 @@ int boundaryCheck2(int val, int minVal, int maxVal, int modVal)
 ! i val\n:  inhib;      // guard window (inhibit follow-on secondary detections)
 ! k val\n:  nrep;       // noise only interval (nrep =0  indicates no noise archiving)
 ! p val\n:  ndel;       // pre-trigger delay 
+! v val\n:  nvote;      // number of channels that must detect
+! f val\n:  cfar;       // target trigger rate per hour (0: fixed threshold)
+! q val\n:  nquant;     // noise percentile (0: exponential average)
+! g val\n:  clsf;       // classifier gate (0: off; min score in percent)
+! l val\n:  ltsa;       // LTSA interval in seconds (0: off)
  */
 
 static void doMenu2(void)
@@ -257,7 +279,7 @@ static void doMenu2(void)
     while(!Serial.available());
     char c=Serial.read();
         
-    if (strchr("oar1234ndtchwseikp", c))
+    if (strchr("oar1234ndtchwseikpvfqgl", c))
     { switch (c)
       { case 'o': acqParameters.on   = boundaryCheck(Serial.parseInt(),0,MAX_VAL); break;
         case 'a': acqParameters.ad   = boundaryCheck(Serial.parseInt(),0,MAX_VAL); break;
@@ -282,21 +304,144 @@ static void doMenu2(void)
                   break;
         //
         #if MDET
-        case 'c': snipParameters.iproc  = boundaryCheck(Serial.parseInt(),0,1); break;
+        case 'c': snipParameters.iproc  = boundaryCheck(Serial.parseInt(),0,2); break;
         case 'h': snipParameters.thresh = boundaryCheck(Serial.parseInt(),-1,MAX_VAL); break;
         case 'w': snipParameters.win0   = boundaryCheck(Serial.parseInt(),0,MAX_VAL); break;
         case 's': snipParameters.win1   = boundaryCheck(Serial.parseInt(),0,MAX_VAL); break;
         case 'e': snipParameters.extr   = boundaryCheck(Serial.parseInt(),0,MAX_VAL); break;
         case 'i': snipParameters.inhib  = boundaryCheck(Serial.parseInt(),0,MAX_VAL); break;
         case 'k': snipParameters.nrep   = boundaryCheck(Serial.parseInt(),0,MAX_VAL); break;
-        case 'p': snipParameters.ndel   = boundaryCheck(Serial.parseInt(),0,MDEL); break;
+        case 'p': snipParameters.ndel   = boundaryCheck(Serial.parseInt(),0,NDEL_MAX); break;
+        case 'v': snipParameters.nvote  = boundaryCheck(Serial.parseInt(),1,NCH); break;
+        case 'f': snipParameters.cfar   = boundaryCheck(Serial.parseInt(),0,MAX_VAL); break;
+        case 'q': snipParameters.nquant = boundaryCheck(Serial.parseInt(),0,99); break;
+        case 'g': snipParameters.clsf = boundaryCheck(Serial.parseInt(),0,100); break;
         #endif
+        case 'l': snipParameters.ltsa = boundaryCheck(Serial.parseInt(),0,3600); break;
         default: break;
 
       }
     }  
 }
 
+// range check of parameters received as binary block (same limits as doMenu2)
+static void checkParameters(ACQ_Parameters_s *acq, SNIP_Parameters_s *snip)
+{
+  acq->on = boundaryCheck(acq->on,0,MAX_VAL);
+  acq->ad = boundaryCheck(acq->ad,0,MAX_VAL);
+  acq->ar = boundaryCheck(acq->ar,0,MAX_VAL);
+  acq->T1 = boundaryCheck(acq->T1,0,24);
+  acq->T2 = boundaryCheck(acq->T2,acq->T1,24);
+  acq->T3 = boundaryCheck(acq->T3,acq->T2,24);
+  acq->T4 = boundaryCheck2(acq->T4,acq->T3,acq->T1,24);
+  acq->name[sizeof(acq->name)-1]=0;
+  snip->iproc  = boundaryCheck(snip->iproc,0,2);
+  snip->thresh = boundaryCheck(snip->thresh,-1,MAX_VAL);
+  snip->win0   = boundaryCheck(snip->win0,0,MAX_VAL);
+  snip->win1   = boundaryCheck(snip->win1,0,MAX_VAL);
+  snip->extr   = boundaryCheck(snip->extr,0,MAX_VAL);
+  snip->inhib  = boundaryCheck(snip->inhib,0,MAX_VAL);
+  snip->nrep   = boundaryCheck(snip->nrep,0,MAX_VAL);
+  snip->ndel   = boundaryCheck(snip->ndel,0,NDEL_MAX);
+  snip->nvote  = boundaryCheck(snip->nvote,1,NCH);
+  snip->cfar   = boundaryCheck(snip->cfar,0,MAX_VAL);
+  snip->nquant = boundaryCheck(snip->nquant,0,99);
+  snip->clsf   = boundaryCheck(snip->clsf,0,100);
+  snip->ltsa   = boundaryCheck(snip->ltsa,0,3600);
+}
+
+// one binary frame (after PROTO_SYNC0, see m_proto.h); returns exit value as menu 'x' (0: stay in menu)
+// list and read replies are built in diskBuffer (unused in menu mode), so the stack stays small
+static_assert(4+PROTO_CHUNK <= sizeof(diskBuffer) && 2+PROTO_LISTLEN <= sizeof(diskBuffer), "doBinary: diskBuffer too small");
+static int16_t doBinary(void)
+{
+  static uint8_t payload[PROTO_MAXLEN];
+  uint8_t hdr[4], status;
+  int16_t len = protoRead(hdr, payload, &status);
+  if(len<0) return 0; // not a frame: ignore
+  uint8_t cmd=hdr[1];
+  if(status!=PROTO_OK) { protoWrite(cmd, status, 0, 0); return 0;}
+
+  const uint16_t nacq=sizeof(ACQ_Parameters_s), nsnip=sizeof(SNIP_Parameters_s);
+  int32_t ret=0;
+  switch(cmd)
+  {
+    case PROTO_STATUS:
+    { PROTO_Status_s st;
+      st.version=PROTO_VERSION; st.nacq=nacq; st.nsnip=nsnip;
+      st.nch=NCH; st.acq=ACQ; st.fsamp=F_SAMP; st.mdel=MDEL;
+      st.time=rtc_get(); st.millis=millis();
+      memcpy(st.name, acqParameters.name, sizeof(st.name));
+      protoWrite(cmd, PROTO_OK, &st, sizeof(st));
+      break;
+    }
+    case PROTO_GET:
+      memcpy(payload, &acqParameters, nacq);
+      memcpy(payload+nacq, &snipParameters, nsnip);
+      protoWrite(cmd, PROTO_OK, payload, nacq+nsnip);
+      break;
+    case PROTO_SET:
+      if(len!=nacq+nsnip) { protoWrite(cmd, PROTO_ELEN, 0, 0); break;}
+      memcpy(&acqParameters, payload, nacq);
+      memcpy(&snipParameters, payload+nacq, nsnip);
+      checkParameters(&acqParameters, &snipParameters);
+      memcpy(payload, &acqParameters, nacq); // reply with values in use
+      memcpy(payload+nacq, &snipParameters, nsnip);
+      protoWrite(cmd, PROTO_OK, payload, nacq+nsnip);
+      break;
+    case PROTO_RTC:
+      if(len!=4) { protoWrite(cmd, PROTO_ELEN, 0, 0); break;}
+      { uint32_t tt; memcpy(&tt, payload, 4);
+        Teensy3Clock.set(tt);
+        setTime(tt);
+      }
+      protoWrite(cmd, PROTO_OK, 0, 0);
+      break;
+    case PROTO_EXIT:
+      if(len!=4) { protoWrite(cmd, PROTO_ELEN, 0, 0); break;}
+      memcpy(&ret, payload, 4);
+      protoWrite(cmd, PROTO_OK, 0, 0);
+      break;
+    case PROTO_LIST:
+      if(len!=2) { protoWrite(cmd, PROTO_ELEN, 0, 0); break;}
+      { uint8_t *list=(uint8_t *)diskBuffer;
+        int32_t nbytes;
+        int16_t count=uSD.listFiles(list+2, PROTO_LISTLEN, payload[0] | (payload[1]<<8), &nbytes);
+        memcpy(list, &count, 2);
+        protoWrite(cmd, PROTO_OK, list, 2+nbytes);
+      }
+      break;
+    case PROTO_READ:
+      if(len<5 || len>=PROTO_MAXLEN) { protoWrite(cmd, PROTO_ELEN, 0, 0); break;}
+      payload[len]=0;
+      { uint32_t offset; memcpy(&offset, payload, 4);
+        int32_t size=uSD.openRead((char *)payload+4);
+        if(size<0 || offset>(uint32_t)size) { uSD.closeRead(); protoWrite(cmd, PROTO_EFILE, 0, 0); break;}
+        uint8_t *chunk=(uint8_t *)diskBuffer;
+        while(offset<(uint32_t)size && !Serial.available())
+        { int32_t nb=uSD.readAt(offset, chunk+4, PROTO_CHUNK);
+          if(nb<=0) break;
+          memcpy(chunk, &offset, 4);
+          protoWrite(cmd, PROTO_OK, chunk, 4+nb);
+          offset += nb;
+        }
+        uSD.closeRead();
+        if(offset<(uint32_t)size) break; // aborted by host (or read error): no end frame
+        memcpy(chunk, &offset, 4);
+        protoWrite(cmd, PROTO_OK, chunk, 4);
+      }
+      break;
+    case PROTO_DELETE:
+      if(len<1 || len>=PROTO_MAXLEN) { protoWrite(cmd, PROTO_ELEN, 0, 0); break;}
+      payload[len]=0;
+      protoWrite(cmd, uSD.removeFile((char *)payload)? PROTO_OK: PROTO_EFILE, 0, 0);
+      break;
+    default:
+      protoWrite(cmd, PROTO_ECMD, 0, 0);
+  }
+  return ret;
+}
+
 int16_t doMenu(void)
 {
   int16_t ret=0;
@@ -314,6 +459,7 @@ int16_t doMenu(void)
         case 'a': printAll(); break;
       }
     }
+    else if(c==(char)PROTO_SYNC0) ret=doBinary();
   } while(ret==0);
   return ret;
 }
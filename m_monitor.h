@@ -0,0 +1,124 @@
+/* Sound Recorder for Teensy 3.6
+ * Copyright (c) 2018, Walter Zimmer
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef M_MONITOR_H
+#define M_MONITOR_H
+
+/*
+ * live monitor over USB serial (see MONITOR in config.h and src/monitor.py)
+ *
+ * loop() hands every acquired multiplexed block to add() after the storage path:
+ * the block is decimated (mean of MONITOR samples per channel) and framed into a RAM ring;
+ * service() sends only what fits into the free USB transmit buffer, so it never blocks.
+ * if the host does not keep up (or no host is connected) whole frames are dropped, never recording data.
+ * other unsolicited frames (telemetry) go through addFrame() into the same ring, so they never split a data frame.
+ *
+ * frame as m_proto.h reply (cmd PROTO_MONITOR|0x80, status PROTO_OK), payload:
+ *   uint32 seq; uint32 dropped frames; uint32 fsamp (decimated); uint8 nch; uint8 decim; uint16 nsamp (per channel);
+ *   int16 data[nsamp][nch]
+ */
+#include "m_proto.h"
+
+#define MON_NSAMP (AUDIO_BLOCK_SAMPLES/MONITOR)
+#define MON_FRAME (7+16+2*MON_NSAMP*NCH+2)
+#ifndef MON_RING
+  #define MON_RING 8192 // bytes
+#endif
+
+class mMonitor
+{
+public:
+  mMonitor(void) : head(0), tail(0), seq(0), dropped(0) {}
+  void add(int16_t *data);
+  int16_t addFrame(uint8_t cmd, const void *data, uint16_t len);
+  void service(void);
+  uint32_t getDropped(void) {return dropped;}
+
+private:
+  uint8_t ring[MON_RING];
+  uint32_t head, tail; // free running byte counts
+  uint32_t seq, dropped;
+  uint8_t frame[MON_FRAME];
+  void put(const uint8_t *src, uint32_t n);
+};
+
+void mMonitor::put(const uint8_t *src, uint32_t n)
+{
+  for(uint32_t ii=0; ii<n; ii++) ring[(head+ii) % MON_RING]=src[ii];
+  head += n;
+}
+
+void mMonitor::add(int16_t *data)
+{
+  seq++;
+  if(!Serial || (MON_RING-(head-tail) < MON_FRAME)) { dropped++; return;}
+
+  uint8_t *ptr=frame;
+  uint16_t len=1+16+2*MON_NSAMP*NCH;
+  *ptr++=PROTO_SYNC0; *ptr++=PROTO_SYNC1; *ptr++=PROTO_VERSION; *ptr++=PROTO_MONITOR|0x80;
+  *ptr++=len & 0xff; *ptr++=len>>8; *ptr++=PROTO_OK;
+  uint32_t fsamp=F_SAMP/MONITOR;
+  memcpy(ptr, &seq, 4); memcpy(ptr+4, &dropped, 4); memcpy(ptr+8, &fsamp, 4);
+  ptr[12]=NCH; ptr[13]=MONITOR; ptr[14]=MON_NSAMP & 0xff; ptr[15]=MON_NSAMP>>8;
+  ptr += 16;
+  int16_t *out=(int16_t *)ptr;
+  for(int ii=0; ii<MON_NSAMP; ii++)
+    for(int jj=0; jj<NCH; jj++)
+    { int32_t sum=0;
+      for(int kk=0; kk<MONITOR; kk++) sum += data[(ii*MONITOR+kk)*NCH+jj];
+      *out++ = sum/MONITOR;
+    }
+  ptr += 2*MON_NSAMP*NCH;
+  uint16_t crc=protoCrc(frame+2, ptr-frame-2);
+  *ptr++=crc & 0xff; *ptr++=crc>>8;
+  put(frame, ptr-frame);
+}
+
+// queue a reply frame (m_proto.h) behind pending data; returns 0 if dropped
+int16_t mMonitor::addFrame(uint8_t cmd, const void *data, uint16_t len)
+{
+  if(!Serial || (MON_RING-(head-tail) < (uint32_t)len+9)) return 0;
+  uint8_t hdr[7] = {PROTO_SYNC0, PROTO_SYNC1, PROTO_VERSION, (uint8_t)(cmd|0x80),
+                    (uint8_t)((len+1) & 0xff), (uint8_t)((len+1)>>8), PROTO_OK};
+  uint16_t crc = protoCrc((const uint8_t *)data, len, protoCrc(hdr+2, 5));
+  uint8_t tl[2] = {(uint8_t)(crc & 0xff), (uint8_t)(crc>>8)};
+  put(hdr, 7);
+  put((const uint8_t *)data, len);
+  put(tl, 2);
+  return 1;
+}
+
+// send pending bytes without blocking
+void mMonitor::service(void)
+{
+  while(head!=tail)
+  { int n=Serial.availableForWrite();
+    if(n<=0) return;
+    uint32_t pend=head-tail;
+    uint32_t off=tail % MON_RING;
+    if((uint32_t)n>pend) n=pend;
+    if((uint32_t)n>MON_RING-off) n=MON_RING-off;
+    Serial.write(&ring[off], n);
+    tail += n;
+  }
+}
+
+#endif
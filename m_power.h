@@ -0,0 +1,201 @@
+/* Sound Recorder for Teensy 3.6
+ * Copyright (c) 2018, Walter Zimmer
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef M_POWER_H
+#define M_POWER_H
+
+/*
+ * CPU clock scaling and energy estimate
+ *
+ * with CPU_SCALING the core runs at bus clock (e.g. 48 MHz for F_CPU 96 MHz, 60 MHz for 180 MHz)
+ * during steady recording; boost() returns to F_CPU for heavy phases (file open/close, classifier,
+ * TDOA, event log, disk writes in storeBlock) and relax() goes back to low clock when the last boost is released.
+ * the core divider (OUTDIV1) changes: PLL and bus clocks are untouched, so the I2S MCLK (from PLL)
+ * and the ADC PDB timer (bus clock) do not glitch. at F_CPU 180 and 216 MHz the I2S MCLK is derived
+ * from the core clock (MCLK_SRC 0), myAPP.cpp then passes scaling 0. core must be an integer multiple of bus and flash:
+ * where the flash divider (OUTDIV4) is no multiple of the bus divider (F_CPU 120 and 180 MHz)
+ * flash is slowed to the next multiple at low clock (180 MHz: 25.7 -> 20 MHz); HSRUN is kept.
+ * systick is reloaded at the next tick (millis() stays correct to about 1 ms per switch,
+ * micros() only within the current ms). hibernation in HSRUN (kinetis_hsrun_disable/enable) rewrites
+ * SIM_CLKDIV1, so resync() is called after a FAST_RESUME wake-up. SDIO and UART0/1 run slower at low clock, so disk writes
+ * of storeBlock are boosted (latency as without scaling); spill ring writes (m_spill.h) are not.
+ *
+ * residency (cycles per clock, update() at least every 20 s) gives an energy estimate from a linear
+ * current model (PWR_MA0 + PWR_MA_MHZ * MHz at PWR_VOLT), reported per hour of recorded data.
+ *
+ * loop() appends one PWR_Record_s (32 bytes) per interval (PWR_INTERVAL, at the next file close or while
+ * no file is open, or before hibernation)
+ * to "Power_<name>.bin"; src/energy.py uses these and the boot records (m_boot.h)
+ * to calibrate its battery and card planning.
+ */
+#include "core_pins.h"
+
+#ifndef PWR_MA0
+  #define PWR_MA0     12.0f  // board current (mA) at zero clock (SD, regulator, mic)
+#endif
+#ifndef PWR_MA_MHZ
+  #define PWR_MA_MHZ  0.33f  // additional current per MHz core clock (mA)
+#endif
+#ifndef PWR_VOLT
+  #define PWR_VOLT    3.3f
+#endif
+#ifndef PWR_INTERVAL
+  #define PWR_INTERVAL 3600  // seconds between power records while awake
+#endif
+
+typedef struct
+{ uint32_t time;            // end of interval (RTC)
+  uint32_t sleep;           // hibernation following the interval (s, 0: none)
+  uint32_t fastMs, slowMs;  // time at F_CPU and at low clock
+  uint32_t samples;         // stored samples (per channel)
+  uint32_t fsamp;
+  uint16_t mhz[2];          // F_CPU and low clock in MHz
+  uint8_t  nch;
+  uint8_t  mode;            // hibernation: 0 VLLS0, 1 LLS (FAST_RESUME)
+  uint16_t reserved;
+} PWR_Record_s;
+
+class mPower
+{
+public:
+  mPower(void) : nboost(0) {}
+  void begin(int16_t scaling);
+  void boost(void);
+  void relax(void);
+  void resync(void);
+  void update(void);
+  void addRecorded(uint32_t nsamp) {recSamples += nsamp;}
+  uint32_t getMHz(void) {return fcpu/1000000;}
+  float fastPercent(void) { float t=tFast()+tSlow(); return (t>0)? 100.0f*tFast()/t: 0.0f;}
+  float energy_mWh(void);                 // since resetStats()
+  float mWhPerHour(uint32_t fsamp);       // per hour of recorded data
+  void resetStats(void) {update(); cycFast=cycSlow=0; recSamples=0;}
+  void getRecord(PWR_Record_s *rec, uint32_t tnow, uint32_t sleep, uint32_t fsamp, uint8_t nch, uint8_t mode);
+
+private:
+  uint32_t clkdiv;          // SIM_CLKDIV1 at boot (fast)
+  uint32_t clkslow;         // SIM_CLKDIV1 at low clock
+  uint32_t fslow, fcpu;     // low and actual core clock
+  int16_t scaling, nboost;
+  uint32_t lastCyc;
+  uint64_t cycFast, cycSlow; // cycles at each clock (float sums stop growing after some minutes)
+  uint64_t recSamples;
+  float tFast(void) {return (float)cycFast/F_CPU;} // seconds
+  float tSlow(void) {return fslow? (float)cycSlow/fslow: 0.0f;}
+  void setClock(int16_t fast);
+};
+
+void mPower::begin(int16_t scaling_)
+{
+  scaling=scaling_;
+  clkdiv=SIM_CLKDIV1;
+  uint32_t d1 = ((clkdiv>>28) & 0xf) + 1; // OUTDIV1: core
+  uint32_t d2 = ((clkdiv>>24) & 0xf) + 1; // OUTDIV2: bus
+  uint32_t d4 = ((clkdiv>>16) & 0xf) + 1; // OUTDIV4: flash
+  d4 = ((d4+d2-1)/d2)*d2;                 // core = bus must be an integer multiple of flash
+  fcpu=F_CPU;
+  fslow = (uint32_t)((uint64_t)F_CPU*d1/d2); // core = bus
+  clkslow = (clkdiv & 0x00f0ffff) | ((d2-1)<<28) | ((d2-1)<<24) | ((d4-1)<<16);
+  if(d2<=d1 || d4>16) scaling=0; // core already at bus clock or no valid flash divider
+  ARM_DEMCR |= ARM_DEMCR_TRCENA;
+  ARM_DWT_CTRL |= ARM_DWT_CTRL_CYCCNTENA;
+  lastCyc=ARM_DWT_CYCCNT;
+  cycFast=cycSlow=0;
+  recSamples=0;
+  nboost=0;
+  if(scaling) setClock(0);
+}
+
+void mPower::update(void)
+{
+  uint32_t cyc=ARM_DWT_CYCCNT;
+  if(fcpu==F_CPU) cycFast += cyc-lastCyc; else cycSlow += cyc-lastCyc;
+  lastCyc=cyc;
+}
+
+void mPower::setClock(int16_t fast)
+{
+  uint32_t f = fast? F_CPU: fslow;
+  if(f==fcpu) return;
+  update();
+  __disable_irq();
+  SIM_CLKDIV1 = fast? clkdiv: clkslow; // core and flash dividers in one write
+  SYST_RVR = f/1000 - 1; // takes effect at next tick
+  fcpu=f;
+  lastCyc=ARM_DWT_CYCCNT;
+  __enable_irq();
+}
+
+// after hibernation: take the dividers as found (boot values after kinetis_hsrun_enable), then restore the wanted clock
+void mPower::resync(void)
+{
+  update();
+  __disable_irq();
+  fcpu = (SIM_CLKDIV1==clkslow)? fslow: F_CPU;
+  SYST_RVR = fcpu/1000 - 1;
+  lastCyc=ARM_DWT_CYCCNT;
+  __enable_irq();
+  setClock(!scaling || nboost);
+}
+
+void mPower::boost(void)
+{
+  if(!scaling) return;
+  if(nboost++==0) setClock(1);
+}
+
+void mPower::relax(void)
+{
+  if(!scaling || nboost==0) return;
+  if(--nboost==0) setClock(0);
+}
+
+// fill record of interval since resetStats()
+void mPower::getRecord(PWR_Record_s *rec, uint32_t tnow, uint32_t sleep, uint32_t fsamp, uint8_t nch, uint8_t mode)
+{
+  update();
+  rec->time=tnow;
+  rec->sleep=sleep;
+  rec->fastMs=(uint32_t)(cycFast/(F_CPU/1000));
+  rec->slowMs=fslow? (uint32_t)(cycSlow/(fslow/1000)): 0;
+  rec->samples=(recSamples>0xffffffff)? 0xffffffff: (uint32_t)recSamples;
+  rec->fsamp=fsamp;
+  rec->mhz[0]=F_CPU/1000000;
+  rec->mhz[1]=fslow/1000000;
+  rec->nch=nch;
+  rec->mode=mode;
+  rec->reserved=0;
+}
+
+float mPower::energy_mWh(void)
+{
+  update();
+  float mAs = (PWR_MA0 + PWR_MA_MHZ*F_CPU/1e6f)*tFast() + (PWR_MA0 + PWR_MA_MHZ*fslow/1e6f)*tSlow();
+  return mAs*PWR_VOLT/3600.0f;
+}
+
+float mPower::mWhPerHour(uint32_t fsamp)
+{
+  float hours = (float)recSamples/fsamp/3600.0f;
+  return (hours>0)? energy_mWh()/hours: 0.0f;
+}
+
+#endif
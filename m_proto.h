@@ -0,0 +1,124 @@
+/* Sound Recorder for Teensy 3.6
+ * Copyright (c) 2018, Walter Zimmer
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef M_PROTO_H
+#define M_PROTO_H
+
+/*
+ * framed binary commands for provisioning (next to the text menu of m_menu.h, see src/provision.py)
+ *
+ * frame (little endian): uint8 0xA5, uint8 0x5A, uint8 version, uint8 cmd, uint16 len, payload[len],
+ *                        uint16 crc (CRC-16/CCITT-FALSE over version .. payload)
+ * the reply echoes cmd with bit 7 set; its payload starts with a status byte (PROTO_OK, ...)
+ * frames of other protocol versions are answered with PROTO_EVERSION (and the own version in the header)
+ *
+ * commands  PROTO_STATUS   -> PROTO_Status_s
+ *           PROTO_GET      -> ACQ_Parameters_s, SNIP_Parameters_s
+ *           PROTO_SET      ACQ_Parameters_s, SNIP_Parameters_s (values are range checked as in the menu)
+ *           PROTO_RTC      uint32 seconds since 1970
+ *           PROTO_EXIT     int32 as menu 'x' (minutes to hibernate, -1: start immediately)
+ *           PROTO_LIST     uint16 start -> uint16 count, count x {uint32 size; uint8 n; char name[n]} (files in root)
+ *           PROTO_READ     uint32 offset, char name[] -> stream of PROTO_READ replies: uint32 offset, data[<=PROTO_CHUNK]
+ *                          ending with an empty chunk whose offset is the file size; any byte sent by the host aborts
+ *                          the stream, so the host resumes with a new PROTO_READ from the last good offset
+ *           PROTO_DELETE   char name[]
+ */
+#define PROTO_SYNC0   0xA5
+#define PROTO_SYNC1   0x5A
+#define PROTO_VERSION 1
+#define PROTO_MAXLEN  256
+#define PROTO_TIMEOUT 200 // ms per frame
+
+#define PROTO_STATUS  0x01
+#define PROTO_GET     0x02
+#define PROTO_SET     0x03
+#define PROTO_RTC     0x04
+#define PROTO_EXIT    0x05
+#define PROTO_LIST    0x06
+#define PROTO_READ    0x07
+#define PROTO_DELETE  0x08
+#define PROTO_MONITOR 0x10 // unsolicited live data (m_monitor.h)
+#define PROTO_TELEMETRY 0x11 // unsolicited status record (m_telemetry.h)
+
+#define PROTO_OK        0
+#define PROTO_ECRC      1
+#define PROTO_EVERSION  2
+#define PROTO_ECMD      3
+#define PROTO_ELEN      4
+#define PROTO_EFILE     5
+
+#define PROTO_LISTLEN 1024 // bytes per directory reply
+#define PROTO_CHUNK   4096 // bytes per data reply
+
+typedef struct
+{ uint16_t version;  // PROTO_VERSION
+  uint16_t nacq;     // sizeof(ACQ_Parameters_s)
+  uint16_t nsnip;    // sizeof(SNIP_Parameters_s)
+  uint8_t  nch;
+  uint8_t  acq;      // ACQ interface
+  uint32_t fsamp;
+  int32_t  mdel;
+  uint32_t time;     // RTC
+  uint32_t millis;
+  char name[8];
+} PROTO_Status_s;
+
+static uint16_t protoCrc(const uint8_t *data, uint16_t len, uint16_t crc=0xffff)
+{
+  while(len--)
+  { crc ^= (uint16_t)(*data++)<<8;
+    for(int ii=0; ii<8; ii++) crc = (crc & 0x8000)? (crc<<1)^0x1021: crc<<1;
+  }
+  return crc;
+}
+
+// read rest of frame after PROTO_SYNC0; returns payload length, -1 on timeout or framing error
+// hdr receives version, cmd, len
+static int16_t protoRead(uint8_t *hdr, uint8_t *payload, uint8_t *status)
+{
+  uint8_t crc[2];
+  Serial.setTimeout(PROTO_TIMEOUT);
+  if(Serial.readBytes((char *)hdr, 1)!=1 || hdr[0]!=PROTO_SYNC1) return -1;
+  if(Serial.readBytes((char *)hdr, 4)!=4) return -1;
+  uint16_t len = hdr[2] | (hdr[3]<<8);
+  if(len>PROTO_MAXLEN) return -1;
+  if(Serial.readBytes((char *)payload, len)!=len) return -1;
+  if(Serial.readBytes((char *)crc, 2)!=2) return -1;
+  *status = PROTO_OK;
+  if(protoCrc(payload, len, protoCrc(hdr, 4)) != (crc[0] | (crc[1]<<8))) *status = PROTO_ECRC;
+  else if(hdr[0]!=PROTO_VERSION) *status = PROTO_EVERSION;
+  return len;
+}
+
+// send reply: status byte followed by data
+static void protoWrite(uint8_t cmd, uint8_t status, const void *data, uint16_t len)
+{
+  uint8_t hdr[7] = {PROTO_SYNC0, PROTO_SYNC1, PROTO_VERSION, (uint8_t)(cmd|0x80),
+                    (uint8_t)((len+1) & 0xff), (uint8_t)((len+1)>>8), status};
+  uint16_t crc = protoCrc((uint8_t *)data, len, protoCrc(hdr+2, 5));
+  uint8_t tail[2] = {(uint8_t)(crc & 0xff), (uint8_t)(crc>>8)};
+  Serial.write(hdr, 7);
+  if(len) Serial.write((const uint8_t *)data, len);
+  Serial.write(tail, 2);
+  Serial.send_now();
+}
+
+#endif
@@ -0,0 +1,87 @@
+/* Sound Recorder for Teensy 3.6
+ * Copyright (c) 2018, Walter Zimmer
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef M_QUANTILE_H
+#define M_QUANTILE_H
+
+/*
+ * streaming quantile noise floor estimator
+ *
+ * tracks the 'percent' percentile of block energy in the log2 domain (16 fractional bits)
+ * each block the estimate moves up by 'up' if the energy is above the estimate
+ * and down by 'down' otherwise; with up/down = percent/(100-percent)
+ * the estimate settles where 'percent' % of the blocks are below it.
+ * A loud event can move the estimate only by 'up' per block, i.e. it is robust to bursts.
+ * Steps are derived from win0 (no detection) and win1 (detection active) in begin(),
+ * so the per-block update needs no divide and one int32 of state per estimate.
+ */
+
+// log2 of x with 16 fractional bits (linear interpolation of mantissa)
+static inline int32_t mLog2q16(uint32_t x)
+{ if(x==0) return 0;
+  int32_t n = 31-__builtin_clz(x);
+  uint32_t f = (n>=16)? (x>>(n-16)) : (x<<(16-n));
+  return (n<<16) | (f & 0xffff);
+}
+
+// inverse of mLog2q16
+static inline uint32_t mExp2q16(int32_t lx)
+{ if(lx<0) return 0;
+  int32_t n = lx>>16;
+  uint32_t m = (1<<16) | (lx & 0xffff);
+  if(n>31) return 0xffffffff;
+  if(n>=16) return m<<(n-16);
+  return m>>(16-n);
+}
+
+class mQuantile
+{
+public:
+  void begin(int32_t percent, int32_t win0, int32_t win1);
+  // lest: actual estimate (from mLog2q16), x: new block energy, slow: use win1 steps
+  // estimate does not go below 0 (energy 1), so a silent or missing channel keeps a non-zero noise floor
+  inline int32_t update(int32_t lest, uint32_t x, int16_t slow)
+  { if(mLog2q16(x) > lest) return lest+up[slow];
+    lest -= down[slow];
+    return (lest<0)? 0: lest;
+  }
+
+private:
+  int32_t up[2], down[2];
+};
+
+void mQuantile::begin(int32_t percent, int32_t win0, int32_t win1)
+{ if(percent<1) percent=1;
+  if(percent>99) percent=99;
+  if(win0<1) win0=1;
+  if(win1<1) win1=1;
+  // within one window the estimate can move by at most 4 octaves (4<<16 in log2q16)
+  up[0]   = ((4<<16)/win0 * percent)/100;
+  down[0] = ((4<<16)/win0 * (100-percent))/100;
+  up[1]   = ((4<<16)/win1 * percent)/100;
+  down[1] = ((4<<16)/win1 * (100-percent))/100;
+  for(int ii=0; ii<2; ii++)
+  { if(up[ii]<1) up[ii]=1;
+    if(down[ii]<1) down[ii]=1;
+  }
+}
+
+#endif
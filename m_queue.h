@@ -130,4 +130,121 @@ void mRecordQueue<mq>::update(void)
 	}
 }
 
+
+// WMXZ frame synchronous queue for all channels
+// one entry holds the blocks of all nch inputs that arrived in the same update cycle (a frame)
+// frames are accepted or dropped as a whole, so channels cannot get out of step on overflow
+// missing input blocks are stored as NULL and returned as NULL data pointers
+template <int nch, int mq>
+class mFrameQueue : public AudioStream
+{
+public:
+  mFrameQueue(void) : AudioStream(nch, inputQueueArray),
+    dropCount(0), maxCount(0), user(0), head(0), tail(0), enabled(0), limit(mq-1) { }
+
+  void begin(void) { clear(); enabled = 1;}
+  // queue at most n frames (1 .. mq-1); frees audio blocks for a longer pre-trigger delay
+  void setLimit(uint16_t n) { limit = (n<1)? 1: (n>mq-1)? mq-1: n; }
+  uint16_t getLimit(void) { return limit; }
+  void end(void) { enabled = 0; }
+  uint16_t available(void);
+  void clear(void);
+  int16_t ** readFrame(void);
+  void freeFrame(void);
+  virtual void update(void);
+  uint32_t dropCount;
+  volatile uint16_t maxCount; // high-water mark of queued frames (reset by user)
+private:
+  audio_block_t *inputQueueArray[nch];
+  audio_block_t * volatile queue[mq][nch];
+  audio_block_t *userframe[nch];
+  int16_t *data[nch];
+  int16_t user;
+  volatile uint16_t head, tail, enabled;
+  uint16_t limit;
+  void releaseFrame(audio_block_t **frame)
+  { for(int ii=0; ii<nch; ii++) if(frame[ii]) release(frame[ii]); }
+};
+
+template <int nch, int mq>
+uint16_t mFrameQueue<nch,mq>::available(void)
+{
+  uint16_t h, t;
+
+  h = head;
+  t = tail;
+  if (h >= t) return h - t;
+  return mq + h - t;
+}
+
+template <int nch, int mq>
+void mFrameQueue<nch,mq>::clear(void)
+{
+  uint16_t t;
+
+  if (user) {
+    releaseFrame(userframe);
+    user = 0;
+  }
+  t = tail;
+  while (t != head) {
+    if (++t >= mq) t = 0;
+    releaseFrame((audio_block_t **)queue[t]);
+  }
+  tail = t;
+}
+
+// returns nch data pointers (NULL for missing blocks) or NULL if no frame is available
+// frame stays valid until freeFrame()
+template <int nch, int mq>
+int16_t ** mFrameQueue<nch,mq>::readFrame(void)
+{
+  uint16_t t;
+
+  if (user) return NULL;
+  t = tail;
+  if (t == head) return NULL;
+  if (++t >= mq) t = 0;
+  for(int ii=0; ii<nch; ii++)
+  { userframe[ii] = queue[t][ii];
+    data[ii] = userframe[ii]? userframe[ii]->data: NULL;
+  }
+  user = 1;
+  tail = t;
+  return data;
+}
+
+template <int nch, int mq>
+void mFrameQueue<nch,mq>::freeFrame(void)
+{
+  if (!user) return;
+  releaseFrame(userframe);
+  user = 0;
+}
+
+template <int nch, int mq>
+void mFrameQueue<nch,mq>::update(void)
+{
+  audio_block_t *block[nch];
+  uint16_t h, nblk=0;
+
+  for(int ii=0; ii<nch; ii++) { block[ii] = receiveReadOnly(ii); if(block[ii]) nblk++; }
+  if (!nblk) return;
+  if (!enabled) {
+    releaseFrame(block);
+    return;
+  }
+  h = head + 1;
+  if (h >= mq) h = 0;
+  if ((h == tail) || (available() >= limit)) {
+    releaseFrame(block); // drop incomming frame (all channels)
+    dropCount++; // flag for main to know
+  } else {
+    for(int ii=0; ii<nch; ii++) queue[h][ii] = block[ii]; // store incomming frame
+    head = h;
+    uint16_t n = available();
+    if (n > maxCount) maxCount = n;
+  }
+}
+
 #endif
@@ -0,0 +1,270 @@
+/* Sound Recorder for Teensy 3.6
+ * Copyright (c) 2018, Walter Zimmer
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef M_SCHEDULE_H
+#define M_SCHEDULE_H
+
+/*
+ * acquisition schedule (used by checkDutyCycle in audio_hibernate.h)
+ *
+ * rules are read from "Schedule.txt" on the card (one per line, '#' starts a comment):
+ *   lat 48.14            latitude in degrees (north positive)
+ *   lon 11.58            longitude in degrees (east positive)
+ *   tz 60                offset of RTC time to UTC in minutes
+ *   * 06:30 08:00        days, start, end; days: '*' or list of 1 (Monday) .. 7 (Sunday), e.g. 1-5 or 1,3,6-7
+ *   1-5 SR-30 SR+90      times: HH:MM or SR/SS (sunrise/sunset) with optional +/- minutes
+ *   6,7 SS-60 01:00      end before start: window continues over midnight
+ * without file, the hour windows T1-T2 and T3-T4 of acqParameters are used.
+ *
+ * compile() expands the rules for yesterday, today and tomorrow into sorted, merged intervals
+ * (RTC seconds) covering today and tomorrow; an hourly index gives the first candidate interval,
+ * so isActive() and nextChange() only look at the intervals starting in the same hour.
+ * leaving the two-day horizon recompiles.
+ * no Teensy dependencies, so the logic compiles and runs on the host (test/test_schedule.cpp).
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define SCHED_MAXRULE 16
+#define SCHED_MAXINT (3*SCHED_MAXRULE)
+#define SCHED_NDAY 2 // horizon in days
+
+enum { SCHED_CLOCK=0, SCHED_SUNRISE, SCHED_SUNSET };
+enum { SUN_NORMAL=0, SUN_POLARNIGHT, SUN_MIDNIGHT }; // return of sunTimes
+
+typedef struct
+{ uint8_t days;       // bit 0: Monday .. bit 6: Sunday
+  uint8_t ref1, ref2; // SCHED_CLOCK, SCHED_SUNRISE or SCHED_SUNSET
+  int16_t off1, off2; // minutes after reference
+} SCHED_Rule_s;
+
+typedef struct
+{ uint32_t t1, t2;    // [t1, t2) in RTC seconds
+} SCHED_Interval_s;
+
+class mSchedule
+{
+public:
+  mSchedule(void) : nrule(0), lat(0.0f), lon(0.0f), tz(0), day0(0xffffffff) {}
+  int16_t parse(const char *text, int32_t nbytes);
+  void fromHours(uint32_t T1, uint32_t T2, uint32_t T3, uint32_t T4);
+  void compile(uint32_t tt);
+  int16_t isActive(uint32_t tt);
+  uint32_t nextChange(uint32_t tt);
+  static int16_t sunTimes(int32_t day, float lat, float lon, int16_t *rise, int16_t *set);
+  int16_t getCount(void) {return nint;}
+  SCHED_Interval_s *getInterval(int16_t ii) {return &interval[ii];}
+
+private:
+  SCHED_Rule_s rule[SCHED_MAXRULE];
+  int16_t nrule;
+  float lat, lon;
+  int16_t tz;
+  uint32_t day0;                            // first day of horizon (days since 1970)
+  SCHED_Interval_s interval[SCHED_MAXINT];
+  int16_t nint;
+  uint8_t first[24*SCHED_NDAY];             // per hour of horizon: first interval with t2 > start of hour
+  int16_t find(uint32_t tt);
+  void addRule(uint8_t days, uint8_t ref1, int16_t off1, uint8_t ref2, int16_t off2);
+};
+
+// sunrise and sunset in minutes after midnight UTC of day (days since 1970); east of about 90 deg rise
+// is negative, west of about -90 deg set exceeds 1440 (NOAA approximation, about 1 minute accuracy at mid latitudes)
+// returns SUN_POLARNIGHT (sun does not rise) or SUN_MIDNIGHT (sun does not set, rise=0 set=1440) otherwise SUN_NORMAL
+int16_t mSchedule::sunTimes(int32_t day, float lat, float lon, int16_t *rise, int16_t *set)
+{
+  // day of year from civil date
+  int32_t z = day + 719468, era = (z>=0? z: z-146096)/146097;
+  int32_t doe = z - era*146097;
+  int32_t yoe = (doe - doe/1460 + doe/36524 - doe/146096)/365;
+  int32_t doy = doe - (365*yoe + yoe/4 - yoe/100);     // days since 1 March
+  int32_t y = yoe + era*400 + (doy>=306);
+  int32_t leap = ((y%4==0) && (y%100!=0)) || (y%400==0);
+  int32_t yday = (doy>=306)? doy-306: doy+59+leap;    // days since 1 January
+  float g = 2.0f*(float)M_PI/(365+leap)*yday;
+  float eqt = 229.18f*(0.000075f + 0.001868f*cosf(g) - 0.032077f*sinf(g) - 0.014615f*cosf(2*g) - 0.040849f*sinf(2*g));
+  float decl = 0.006918f - 0.399912f*cosf(g) + 0.070257f*sinf(g) - 0.006758f*cosf(2*g) + 0.000907f*sinf(2*g)
+             - 0.002697f*cosf(3*g) + 0.00148f*sinf(3*g);
+  float phi = lat*(float)M_PI/180.0f;
+  float c = cosf(90.833f*(float)M_PI/180.0f)/(cosf(phi)*cosf(decl)) - tanf(phi)*tanf(decl);
+  float noon = 720.0f - 4.0f*lon - eqt;
+  if(c>=1.0f) { *rise=0; *set=0; return SUN_POLARNIGHT;}
+  if(c<=-1.0f) { *rise=0; *set=1440; return SUN_MIDNIGHT;}
+  float ha = acosf(c)*180.0f/(float)M_PI;
+  *rise = (int16_t)lroundf(noon - 4.0f*ha);
+  *set  = (int16_t)lroundf(noon + 4.0f*ha);
+  return SUN_NORMAL;
+}
+
+void mSchedule::addRule(uint8_t days, uint8_t ref1, int16_t off1, uint8_t ref2, int16_t off2)
+{
+  if(nrule>=SCHED_MAXRULE) return;
+  SCHED_Rule_s *r = &rule[nrule++];
+  r->days=days; r->ref1=ref1; r->off1=off1; r->ref2=ref2; r->off2=off2;
+  day0=0xffffffff; // recompile
+}
+
+// old style hour windows: T1-T2 and T3-T4 (T4 < T1 continues over midnight)
+void mSchedule::fromHours(uint32_t T1, uint32_t T2, uint32_t T3, uint32_t T4)
+{
+  nrule=0;
+  if(T2>T1) addRule(0x7f, SCHED_CLOCK, T1*60, SCHED_CLOCK, T2*60);
+  if(T4>T3 || T4<T1) addRule(0x7f, SCHED_CLOCK, T3*60, SCHED_CLOCK, T4*60);
+  day0=0xffffffff;
+}
+
+// time field: HH:MM, SR[+-min], SS[+-min]
+static int16_t schedTime(const char *s, uint8_t *ref, int16_t *off)
+{
+  if((s[0]=='S') && (s[1]=='R' || s[1]=='S'))
+  { *ref = (s[1]=='R')? SCHED_SUNRISE: SCHED_SUNSET;
+    *off = (s[2]=='+' || s[2]=='-')? atoi(s+2): 0;
+    return 1;
+  }
+  int hh, mm;
+  if(sscanf(s, "%d:%d", &hh, &mm)!=2 || hh<0 || hh>24 || mm<0 || mm>59) return 0;
+  *ref = SCHED_CLOCK;
+  *off = hh*60+mm;
+  return 1;
+}
+
+// days field: '*' or list of 1..7 and ranges
+static uint8_t schedDays(const char *s)
+{
+  if(s[0]=='*') return 0x7f;
+  uint8_t days=0;
+  while(*s)
+  { if(*s<'1' || *s>'7') return 0;
+    int d1=*s++-'1', d2=d1;
+    if(*s=='-') { s++; if(*s<'1' || *s>'7') return 0; d2=*s++-'1';}
+    for(int ii=d1; ii<=d2; ii++) days |= 1<<ii;
+    if(*s==',') s++;
+  }
+  return days;
+}
+
+// parse schedule text; returns number of rules loaded, 0: no rule found, previous rules and position kept
+int16_t mSchedule::parse(const char *text, int32_t nbytes)
+{
+  char line[64], f1[16], f2[16], f3[16];
+  int16_t n0=nrule;
+  float lat1=lat, lon1=lon;
+  int16_t tz1=tz;
+  nrule=0;
+  for(int32_t ii=0; ii<nbytes; )
+  { int32_t nl=0;
+    while(ii<nbytes && text[ii]!='\n') { if(nl<63) line[nl++]=text[ii]; ii++;}
+    ii++;
+    line[nl]=0;
+    char *cm=strchr(line,'#'); if(cm) *cm=0;
+    int nf=sscanf(line, "%15s %15s %15s", f1, f2, f3);
+    if(nf<=0) continue;
+    if(nf==2 && !strcmp(f1,"lat")) { lat1=atof(f2); continue;}
+    if(nf==2 && !strcmp(f1,"lon")) { lon1=atof(f2); continue;}
+    if(nf==2 && !strcmp(f1,"tz"))  { tz1=atoi(f2);  continue;}
+    uint8_t days, ref1, ref2;
+    int16_t off1, off2;
+    if(nf==3 && (days=schedDays(f1)) && schedTime(f2,&ref1,&off1) && schedTime(f3,&ref2,&off2))
+      addRule(days, ref1, off1, ref2, off2);
+  }
+  if(!nrule) { nrule=n0; return 0;} // rule[] is untouched if nothing was added
+  lat=lat1; lon=lon1; tz=tz1;
+  day0=0xffffffff;
+  return nrule;
+}
+
+// expand rules into sorted, merged intervals for the day of tt and the next one
+void mSchedule::compile(uint32_t tt)
+{
+  day0 = tt/86400;
+  uint32_t h0 = day0*86400, h1 = h0+SCHED_NDAY*86400;
+  nint=0;
+  for(int32_t day=(int32_t)day0-1; day<(int32_t)day0+SCHED_NDAY; day++)
+  { int16_t rise, set;
+    int16_t sun = sunTimes(day, lat, lon, &rise, &set);
+    if(sun==SUN_NORMAL)
+    { // local minutes of this day (RTC time is UTC+tz)
+      rise = ((rise+tz)%1440+1440)%1440;
+      set  = ((set+tz)%1440+1440)%1440;
+    }
+    int32_t wd = (day+3)%7; // 0: Monday (1 Jan 1970 was Thursday)
+    for(int ii=0; ii<nrule; ii++)
+    { SCHED_Rule_s *r = &rule[ii];
+      if(!(r->days & (1<<wd))) continue;
+      if((r->ref1!=SCHED_CLOCK || r->ref2!=SCHED_CLOCK) && sun==SUN_POLARNIGHT) continue; // no sun today
+      int32_t m1 = r->off1 + ((r->ref1==SCHED_SUNRISE)? rise: (r->ref1==SCHED_SUNSET)? set: 0);
+      int32_t m2 = r->off2 + ((r->ref2==SCHED_SUNRISE)? rise: (r->ref2==SCHED_SUNSET)? set: 0);
+      if(m2<=m1) m2 += 1440; // over midnight
+      int64_t t1 = (int64_t)day*86400 + m1*60, t2 = (int64_t)day*86400 + m2*60;
+      if(t1<h0) t1=h0;
+      if(t2>h1) t2=h1;
+      if(t2<=t1 || nint>=SCHED_MAXINT) continue;
+      // insert sorted by start
+      int16_t jj=nint++;
+      while(jj>0 && interval[jj-1].t1>t1) { interval[jj]=interval[jj-1]; jj--;}
+      interval[jj].t1=t1; interval[jj].t2=t2;
+    }
+  }
+  // merge overlapping and touching intervals
+  int16_t nn=0;
+  for(int ii=0; ii<nint; ii++)
+  { if(nn>0 && interval[ii].t1<=interval[nn-1].t2)
+    { if(interval[ii].t2>interval[nn-1].t2) interval[nn-1].t2=interval[ii].t2;}
+    else
+      interval[nn++]=interval[ii];
+  }
+  nint=nn;
+  // hourly index
+  int16_t jj=0;
+  for(int hh=0; hh<24*SCHED_NDAY; hh++)
+  { uint32_t th = h0+hh*3600;
+    while(jj<nint && interval[jj].t2<=th) jj++;
+    first[hh]=jj;
+  }
+}
+
+// index of first interval with t2 > tt (nint: none in horizon)
+int16_t mSchedule::find(uint32_t tt)
+{
+  if(tt/86400<day0 || tt/86400>=day0+SCHED_NDAY) compile(tt);
+  int16_t jj = first[(tt-day0*86400)/3600];
+  while(jj<nint && interval[jj].t2<=tt) jj++;
+  return jj;
+}
+
+int16_t mSchedule::isActive(uint32_t tt)
+{
+  int16_t jj=find(tt);
+  return (jj<nint) && (interval[jj].t1<=tt);
+}
+
+// next time when recording starts or stops (end of horizon if nothing changes before)
+uint32_t mSchedule::nextChange(uint32_t tt)
+{
+  int16_t jj=find(tt);
+  if(jj>=nint) return (day0+SCHED_NDAY)*86400;
+  return (interval[jj].t1<=tt)? interval[jj].t2: interval[jj].t1;
+}
+
+#endif
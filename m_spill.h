@@ -0,0 +1,177 @@
+/* Sound Recorder for Teensy 3.6
+ * Copyright (c) 2018, Walter Zimmer
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef M_SPILL_H
+#define M_SPILL_H
+
+/*
+ * spill-to-SD look-back (see MSPILL in config.h)
+ *
+ * loop() writes every block that is not stored into a circular, preallocated scratch file
+ * "Spill_<name>.bin" (MSPILL seconds); nothing else is kept.
+ * When a file is opened, startCopy() hands the ring (oldest first) to the storage path:
+ * loop() copies SPILL_COPY blocks per live block into the event file (read()),
+ * while live blocks are still appended to the ring, until the copy has caught up.
+ * FAT has no cheap way to move clusters into another file, so promotion is a fast copy.
+ *
+ * SD load: continuous write of the full data rate (e.g. 192 kB/s for stereo 48 kHz)
+ * plus one read per promoted block; each ring pass rewrites the same region of the card.
+ * report() appends to "Spill_<name>.txt": date, time, spilled MB, ring passes,
+ * write MB/s (while writing), copied MB, read MB/s (while reading)
+ */
+#include "SdFat.h"
+
+#define SPILL_BLOCK (AUDIO_BLOCK_SAMPLES*NCH*2) // bytes per multiplexed block
+#define SPILL_NBUF 8                            // blocks kept in RAM before writing to card
+#ifndef SPILL_COPY
+  #define SPILL_COPY 4                          // blocks copied per live block (must be > 1 to catch up)
+#endif
+
+class mSpill
+{
+public:
+  mSpill(void) : size(0) {}
+  int16_t begin(uint32_t nsec, uint32_t fsamp, char *name);
+  void write(int16_t *data);
+  void startCopy(void);
+  int16_t read(int16_t *data);
+  int16_t isCopying(void) {return copying;}
+  void report(char *name);
+
+private:
+  FsFile file;
+  uint32_t size;      // ring size in bytes (multiple of SPILL_BLOCK)
+  uint32_t head;      // next write position on card
+  uint32_t fill;      // valid (not yet promoted) bytes, including RAM buffer
+  uint32_t copyPos, copyLeft;
+  int16_t copying;
+  int16_t nbuf;
+  uint8_t buffer[SPILL_NBUF*SPILL_BLOCK];
+  // statistics
+  uint64_t nWritten, nRead;
+  uint64_t tWrite, tRead; // us (uint32_t wraps after 71 minutes)
+  void flush(void);
+};
+
+int16_t mSpill::begin(uint32_t nsec, uint32_t fsamp, char *name)
+{
+  char fname[24];
+  size = ((uint64_t)nsec*fsamp/AUDIO_BLOCK_SAMPLES)*SPILL_BLOCK;
+  if(size<SPILL_NBUF*SPILL_BLOCK) size=SPILL_NBUF*SPILL_BLOCK;
+  head=fill=copyPos=copyLeft=0;
+  copying=0;
+  nbuf=0;
+  nWritten=nRead=0;
+  tWrite=tRead=0;
+  sprintf(fname, "Spill_%s.bin", name);
+  if(!file.open(fname, O_CREAT | O_TRUNC | O_RDWR)) { size=0; return 0;}
+  if(!file.preAllocate(size)) { file.close(); size=0; return 0;} // contiguous region, no FAT updates while spilling
+  return 1;
+}
+
+// write RAM buffer to ring on card
+void mSpill::flush(void)
+{
+  if(!nbuf) return;
+  uint32_t to=micros();
+  uint8_t *ptr=buffer;
+  uint32_t nbytes=nbuf*SPILL_BLOCK;
+  while(nbytes>0)
+  { uint32_t n = (head+nbytes>size)? size-head: nbytes;
+    file.seekSet(head);
+    file.write(ptr, n);
+    ptr += n;
+    nbytes -= n;
+    head += n;
+    if(head>=size) head=0;
+  }
+  nWritten += nbuf*SPILL_BLOCK;
+  tWrite += micros()-to;
+  nbuf=0;
+}
+
+// append one multiplexed block to the ring (oldest data are overwritten)
+void mSpill::write(int16_t *data)
+{
+  if(!size) return;
+  memcpy(&buffer[nbuf*SPILL_BLOCK], data, SPILL_BLOCK);
+  nbuf++;
+  if(!copying)
+  { fill += SPILL_BLOCK;
+    if(fill>size) fill=size;
+  }
+  else
+  { copyLeft += SPILL_BLOCK;
+    if(copyLeft>size)
+    { // writer overtakes copy: drop oldest not yet copied block
+      copyLeft -= SPILL_BLOCK;
+      copyPos = (copyPos+SPILL_BLOCK) % size;
+    }
+  }
+  if(nbuf>=SPILL_NBUF) flush();
+}
+
+// promote ring content (oldest first) to storage path
+void mSpill::startCopy(void)
+{
+  if(!size || copying) return; // new file while copying (e.g. max file size): continue copy
+  uint32_t last = (head + nbuf*SPILL_BLOCK) % size; // logical write position
+  copyPos = (last + size - fill) % size;
+  copyLeft = fill;
+  fill = 0; // promoted data are not offered again
+  copying = 1;
+}
+
+// next promoted block; returns 0 (and ends copy) when copy has caught up with writer
+int16_t mSpill::read(int16_t *data)
+{
+  if(!copying) return 0;
+  if(!copyLeft) { copying=0; return 0;}
+  if(copyLeft <= (uint32_t)nbuf*SPILL_BLOCK) flush(); // requested data are still in RAM
+  uint32_t to=micros();
+  file.seekSet(copyPos);
+  file.read(data, SPILL_BLOCK);
+  tRead += micros()-to;
+  nRead += SPILL_BLOCK;
+  copyPos = (copyPos+SPILL_BLOCK) % size;
+  copyLeft -= SPILL_BLOCK;
+  return 1;
+}
+
+void mSpill::report(char *name)
+{
+  if(!size) return;
+  char text[80];
+  char fname[24];
+  FsFile txt;
+  sprintf(fname, "Spill_%s.txt", name);
+  if(!txt.open(fname, O_CREAT|O_WRITE|O_APPEND)) return;
+  float mbw = nWritten/1048576.0f;
+  float mbr = nRead/1048576.0f;
+  sprintf(text, "%04d_%02d_%02d,%02d_%02d_%02d,%10.1f,%8.1f,%6.2f,%10.1f,%6.2f\r\n",
+          year(), month(), day(), hour(), minute(), second(),
+          mbw, (float)nWritten/size, tWrite? mbw/((float)tWrite*1e-6f): 0.0f,
+          mbr, tRead? mbr/((float)tRead*1e-6f): 0.0f);
+  txt.write(text, strlen(text));
+  txt.close();
+}
+
+#endif
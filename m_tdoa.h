@@ -0,0 +1,126 @@
+/* Sound Recorder for Teensy 3.6
+ * Copyright (c) 2018, Walter Zimmer
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef M_TDOA_H
+#define M_TDOA_H
+
+/*
+ * time difference of arrival (TDOA) between channel 0 and channels 1 .. nch-1
+ *
+ * the audio interrupt only copies the trigger block and the following block of each channel
+ * (capture), all processing is done by compute() which is called from loop()
+ * so the audio update (update_all) is never delayed.
+ *
+ * GCC-PHAT: cross spectrum of zero padded data (NTDOA*2 point float FFT, CMSIS-DSP)
+ * is whitened and transformed back; the peak within +-TDOA_MAXLAG samples is interpolated
+ * with a parabola. Result is in units of 1/16 sample, positive if channel k is later than channel 0.
+ *
+ * src/tdoa.py runs the same estimator on recorded files and on simulated delays
+ */
+#include "arm_math.h"
+#include "AudioStream.h"
+
+#define NTDOA (2*AUDIO_BLOCK_SAMPLES) // samples per channel used for TDOA
+#define NTFFT (2*NTDOA)               // zero padded FFT length
+#ifndef TDOA_MAXLAG
+  #define TDOA_MAXLAG 64              // max expected delay (samples)
+#endif
+
+template <int nch>
+class mTdoa
+{
+  static_assert(nch<=8, "mTdoa: at most 8 channels (7 delays per event)");
+public:
+  mTdoa(void) : state(0) {}
+  void begin(void) { state=0; if(nch>1) arm_rfft_fast_init_f32(&rfft, NTFFT); }
+  // called from audio interrupt
+  void start(uint32_t block) { if(state==0) { capBlock=block; state=1;} }
+  void capture(audio_block_t **inp);
+  // called from loop()
+  int16_t isReady(void) {return state==3;}
+  uint32_t getBlock(void) {return capBlock;}
+  void compute(int16_t *tdoa);
+
+private:
+  volatile int16_t state; // 0: idle; 1: capture first block; 2: capture second block; 3: ready
+  uint32_t capBlock;      // block index of trigger
+  int16_t data[nch][NTDOA];
+  float32_t buf0[(nch>1)? NTFFT: 1], bufk[(nch>1)? NTFFT: 1], spec[(nch>1)? NTFFT: 1]; // no FFT buffers for mono
+  arm_rfft_fast_instance_f32 rfft;
+};
+
+template <int nch>
+void mTdoa<nch>::capture(audio_block_t **inp)
+{
+  if((state!=1) && (state!=2)) return;
+  int16_t off = (state==1)? 0: AUDIO_BLOCK_SAMPLES;
+  for(int ii=0; ii<nch; ii++)
+  { if(inp[ii]) memcpy(&data[ii][off], inp[ii]->data, AUDIO_BLOCK_SAMPLES*sizeof(int16_t));
+    else memset(&data[ii][off], 0, AUDIO_BLOCK_SAMPLES*sizeof(int16_t));
+  }
+  state++;
+}
+
+template <int nch>
+void mTdoa<nch>::compute(int16_t *tdoa)
+{
+  if(nch<2) { state=0; return;}
+  // spectrum of reference channel
+  for(int ii=0; ii<NTDOA; ii++) bufk[ii]=data[0][ii];
+  for(int ii=NTDOA; ii<NTFFT; ii++) bufk[ii]=0.0f;
+  arm_rfft_fast_f32(&rfft, bufk, buf0, 0);
+
+  for(int kk=1; kk<nch; kk++)
+  {
+    for(int ii=0; ii<NTDOA; ii++) bufk[ii]=data[kk][ii];
+    for(int ii=NTDOA; ii<NTFFT; ii++) bufk[ii]=0.0f;
+    arm_rfft_fast_f32(&rfft, bufk, spec, 0);
+
+    // cross spectrum Xk * conj(X0) with PHAT weighting (packed format: [DC, Nyquist, re1, im1, ...])
+    spec[0] = (spec[0]*buf0[0] >= 0.0f)? 1.0f: -1.0f;
+    spec[1] = (spec[1]*buf0[1] >= 0.0f)? 1.0f: -1.0f;
+    for(int ii=2; ii<NTFFT; ii+=2)
+    { float32_t re = spec[ii]*buf0[ii] + spec[ii+1]*buf0[ii+1];
+      float32_t im = spec[ii+1]*buf0[ii] - spec[ii]*buf0[ii+1];
+      float32_t mag = sqrtf(re*re + im*im) + 1e-20f;
+      spec[ii] = re/mag;
+      spec[ii+1] = im/mag;
+    }
+    arm_rfft_fast_f32(&rfft, spec, bufk, 1);
+
+    // peak search over lags -TDOA_MAXLAG .. TDOA_MAXLAG (negative lags are at end of buffer)
+    int32_t imax=0;
+    float32_t vmax=bufk[0];
+    for(int ll=-TDOA_MAXLAG; ll<=TDOA_MAXLAG; ll++)
+    { float32_t v = bufk[(ll+NTFFT)%NTFFT];
+      if(v>vmax) {vmax=v; imax=ll;}
+    }
+    // parabolic interpolation
+    float32_t ym = bufk[(imax-1+NTFFT)%NTFFT];
+    float32_t yp = bufk[(imax+1+NTFFT)%NTFFT];
+    float32_t den = ym - 2.0f*vmax + yp;
+    float32_t dl = (den<0.0f)? 0.5f*(ym-yp)/den: 0.0f;
+    tdoa[kk-1] = (int16_t)lrintf((imax + dl)*16.0f);
+  }
+  state=0;
+}
+
+#endif
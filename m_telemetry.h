@@ -0,0 +1,159 @@
+/* Sound Recorder for Teensy 3.6
+ * Copyright (c) 2018, Walter Zimmer
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef M_TELEMETRY_H
+#define M_TELEMETRY_H
+
+/*
+ * binary status record (see TELEMETRY in config.h and src/telemetry.py)
+ *
+ * loop() fills one TEL_Record_s every TELEMETRY seconds instead of the DO_DEBUG text statistics.
+ * TEL_OUT 1: sent over USB serial as m_proto.h reply frame (cmd PROTO_TELEMETRY|0x80, status PROTO_OK)
+ *             only while a host is connected; with MONITOR the frame is queued by myAPP.cpp into the
+ *             monitor ring (mMonitor::addFrame), as a direct write could fall into a partly sent live data frame
+ * TEL_OUT 2: kept in RAM and written every TEL_NBUF records into the ring file
+ *             "Telemetry_<name>.bin": TEL_Header_s followed by TEL_NFILE record slots
+ *             (slot of record seq is seq % TEL_NFILE, oldest records are overwritten; header.seq is next seq)
+ *             a new file is written in full (header and zeroed slots) so every slot can be reached by seekSet
+ */
+#include "SdFat.h"
+#include "m_proto.h"
+
+#define TEL_VERSION 1
+#define TEL_MAXCH 8
+#ifndef TEL_NBUF
+  #define TEL_NBUF 16
+#endif
+#ifndef TEL_NFILE
+  #define TEL_NFILE 8192 // about 750 kB
+#endif
+
+typedef struct
+{ uint16_t size;       // sizeof(TEL_Record_s)
+  uint8_t  version;    // TEL_VERSION
+  uint8_t  nch;
+  uint32_t seq;
+  uint32_t time;       // RTC
+  uint32_t millis;
+  uint32_t loops;      // loop() passes in interval
+  uint32_t wrMin, wrMax, wrMean; // disk write latency (us, wrMin 0xffffffff: no write)
+  uint16_t wrCount;    // disk writes
+  uint16_t nbuf;       // uSD.getNbuf()
+  uint16_t audioMax;   // audio blocks in use (max, of MAUDIO)
+  uint16_t queueMax;   // queued frames (max, of MQ-1)
+  uint16_t delayMax;   // blocks in delay line (max)
+  uint16_t mhz;        // actual core clock
+  uint32_t drops;      // frames dropped by queue
+  uint32_t allocFail;  // ISR allocation failures (total, 0xffffffff: not available)
+  uint16_t missing[TEL_MAXCH]; // missing blocks per channel
+  int32_t  sigCount, detCount, threshold; // detector state (0 without detector)
+  uint32_t maxValue, maxNoise;            // max detector signal and noise estimate
+  uint16_t fastPct;    // time at F_CPU (percent, m_power.h)
+  uint16_t mWhh;       // energy per hour of recorded data (0.1 mWh)
+} TEL_Record_s;
+
+typedef struct
+{ char magic[4];       // "MTEL"
+  uint16_t size;       // sizeof(TEL_Record_s)
+  uint16_t nfile;      // TEL_NFILE
+  uint32_t seq;        // next record
+  uint32_t reserved;
+} TEL_Header_s;
+
+class mTelemetry
+{
+public:
+  mTelemetry(void) : seq(0), nbuf(0), open(0) {}
+  void begin(char *name);
+  void add(TEL_Record_s *rec);
+  void flush(void);
+
+private:
+  FsFile file;
+  uint32_t seq;
+  int16_t nbuf, open;
+  TEL_Record_s buffer[TEL_NBUF];
+  void close(void) { file.close(); open=0; nbuf=0;}
+};
+
+void mTelemetry::begin(char *name)
+{
+#if TEL_OUT & 2
+  char fname[32];
+  TEL_Header_s hdr;
+  sprintf(fname, "Telemetry_%s.bin", name);
+  open=0;
+  if(!file.open(fname, O_CREAT | O_RDWR)) return;
+  if(file.read(&hdr, sizeof(hdr))==sizeof(hdr) && !strncmp(hdr.magic, "MTEL", 4)
+     && hdr.size==sizeof(TEL_Record_s) && hdr.nfile==TEL_NFILE
+     && file.fileSize()==sizeof(TEL_Header_s)+TEL_NFILE*sizeof(TEL_Record_s))
+    seq=hdr.seq; // continue ring
+  else
+  { // new ring: header and zeroed slots (buffer is scratch here)
+    file.truncate(0);
+    if(!file.preAllocate(sizeof(TEL_Header_s)+TEL_NFILE*sizeof(TEL_Record_s))) { file.close(); return;}
+    seq=0;
+    TEL_Header_s hdr0 = {{'M','T','E','L'}, sizeof(TEL_Record_s), TEL_NFILE, seq, 0};
+    int16_t ok = file.write(&hdr0, sizeof(hdr0))==sizeof(hdr0);
+    memset(buffer, 0, sizeof(buffer));
+    for(uint32_t nn=0; ok && nn<TEL_NFILE; nn+=TEL_NBUF)
+    { uint32_t nb = ((TEL_NFILE-nn<TEL_NBUF)? TEL_NFILE-nn: TEL_NBUF)*sizeof(TEL_Record_s);
+      ok = file.write(buffer, nb)==nb;
+    }
+    if(!ok) { file.close(); return;}
+    file.sync();
+  }
+  nbuf=0;
+  open=1;
+#endif
+}
+
+void mTelemetry::add(TEL_Record_s *rec)
+{
+  rec->size=sizeof(TEL_Record_s);
+  rec->version=TEL_VERSION;
+  rec->seq=seq++;
+#if (TEL_OUT & 1) && !(MONITOR>0)
+  if(Serial) protoWrite(PROTO_TELEMETRY, PROTO_OK, rec, sizeof(TEL_Record_s));
+#endif
+#if TEL_OUT & 2
+  if(!open) return;
+  buffer[nbuf++]=*rec;
+  if(nbuf>=TEL_NBUF) flush();
+#endif
+}
+
+// write buffered records into their ring slots and update header; a failing seek stops the file output
+void mTelemetry::flush(void)
+{
+  if(!open || !nbuf) return;
+  for(int ii=0; ii<nbuf; ii++)
+  { if(!file.seekSet(sizeof(TEL_Header_s)+(buffer[ii].seq % TEL_NFILE)*sizeof(TEL_Record_s))) { close(); return;}
+    file.write(&buffer[ii], sizeof(TEL_Record_s));
+  }
+  nbuf=0;
+  TEL_Header_s hdr = {{'M','T','E','L'}, sizeof(TEL_Record_s), TEL_NFILE, seq, 0};
+  if(!file.seekSet(0)) { close(); return;}
+  file.write(&hdr, sizeof(hdr));
+  file.sync();
+}
+
+#endif
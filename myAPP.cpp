@@ -67,14 +67,22 @@
 // edits are to be done in the following config.h file
 #include "config.h"
 
+// RAM_SLACK: RAM left for stack, USB, SD and remaining statics (see RAM budget below)
 #if defined(__MK20DX256__)
   #define MAX_Q 100 // number of buffers in aquisition queue
+  #define RAM_SIZE (64*1024)
+  #define RAM_SLACK (10*1024) //<<<======>>>
 #elif defined(__MK64FX512__)
   #define MAX_Q 250 // number of buffers in aquisition queue
+  #define RAM_SIZE (192*1024)
+  #define RAM_SLACK (16*1024) //<<<======>>>
 #elif defined(__MK66FX1M0__)
   #define MAX_Q 500 // number of buffers in aquisition queue
+  #define RAM_SIZE (256*1024)
+  #define RAM_SLACK (16*1024) //<<<======>>>
 #else
-  #define MAX_Q 53 // number of buffers in aquisition queue
+  // Teensy LC: 8 KB RAM do not hold the acquisition queue (53 blocks are about 14 KB)
+  #error "unsupported MCU: needs Teensy 3.2, 3.5 or 3.6"
 #endif
 
 //==================== Audio interface ========================================
@@ -85,6 +93,7 @@
  * the custom multiplex object expects the 'link' to queue update function
  * 
  * PJRC's record_queue is modified to allow variable queue size
+ * and to queue whole frames (one block per channel, mFrameQueue), so channels stay in step on overflow
  * use if different data type requires modification to AudioStream
  * type "int16_t" is compatible with stock AudioStream
  */
@@ -103,25 +112,25 @@
 
   #define MQ (MAX_Q/NCH)
   #include "m_queue.h"
-  mRecordQueue<MQ> queue[NCH];
+  mFrameQueue<NCH,MQ> queue1; // all channels in one frame queue
   
   #if MDEL > 0 
     #include "m_delay.h" 
-    mDelay<NCH,(MDEL+2)>  delay1(0); // have two buffers more in queue only to be safe 
+    mDelay<NCH>  delay1; // ring is sized in setup from snipParameters.ndel
   #endif 
 
   #if MDEL<0
-      AudioConnection     patchCord2(acq, queue[0]); 
+      AudioConnection     patchCord2(acq, queue1); 
   #else
     #include "mProcess.h" 
-    mProcess process1(&snipParameters); 
+    mProcess<NCH> process1(&snipParameters); 
   
     AudioConnection     patchCord1(acq, process1); 
     #if MDEL == 0 
-      AudioConnection     patchCord2(acq, queue[0]); 
+      AudioConnection     patchCord2(acq, queue1); 
     #else 
       AudioConnection     patchCord2(acq, delay1); 
-      AudioConnection     patchCord3(delay1, queue[0]); 
+      AudioConnection     patchCord3(delay1, queue1); 
     #endif 
 
   #endif
@@ -146,36 +155,36 @@
 
   #define MQ (MAX_Q/NCH)
   #include "m_queue.h"
-  mRecordQueue<MQ> queue[NCH];
+  mFrameQueue<NCH,MQ> queue1; // all channels in one frame queue
 
   #if MDEL>0
     #include "m_delay.h" 
-    mDelay<NCH,(MDEL+2)>  delay1(2); // have two buffers more in queue only to be safe 
+    mDelay<NCH>  delay1; // ring is sized in setup from snipParameters.ndel
   #endif 
 
   #if MDEL<0
-    AudioConnection     patchCord3(acq,0, queue[0],0);
-    AudioConnection     patchCord4(acq,1, queue[1],0);
+    AudioConnection     patchCord3(acq,0, queue1,0);
+    AudioConnection     patchCord4(acq,1, queue1,1);
   #else
     #include "mProcess.h"
-    mProcess process1(&snipParameters);
+    mProcess<NCH> process1(&snipParameters);
 
     AudioConnection     patchCord1(acq,0, process1,0);
     AudioConnection     patchCord2(acq,1, process1,1);
     #if MDEL == 0
-      AudioConnection     patchCord3(acq,0, queue[0],0);
-      AudioConnection     patchCord4(acq,1, queue[1],0);
+      AudioConnection     patchCord3(acq,0, queue1,0);
+      AudioConnection     patchCord4(acq,1, queue1,1);
     #else
       AudioConnection     patchCord3(acq,0, delay1,0);
       AudioConnection     patchCord4(acq,1, delay1,1);
-      AudioConnection     patchCord5(delay1,0, queue[0],0);
-      AudioConnection     patchCord6(delay1,1, queue[1],0);
+      AudioConnection     patchCord5(delay1,0, queue1,0);
+      AudioConnection     patchCord6(delay1,1, queue1,1);
     #endif
   #endif
 
 
 /*-------------------------- (quad channel) -----------------------------*/
-#elif ACQ == _I2S_QUAD      // not yet modified for event detections and delays
+#elif ACQ == _I2S_QUAD
   #define NCH 4
   
   #include "input_i2s_quad.h"
@@ -183,16 +192,46 @@
   
   #define MQ (MAX_Q/NCH)
   #include "m_queue.h"
-  mRecordQueue<MQ> *queue = new mRecordQueue<MQ> [NCH];
+  mFrameQueue<NCH,MQ> queue1; // all channels in one frame queue
 
-  AudioConnection     patchCord1(acq,0, queue[0],0);
-  AudioConnection     patchCord2(acq,1, queue[1],0);
-  AudioConnection     patchCord3(acq,2, queue[2],0);
-  AudioConnection     patchCord4(acq,3, queue[3],0);
+  #if MDEL>0
+    #include "m_delay.h" 
+    mDelay<NCH>  delay1; // ring is sized in setup from snipParameters.ndel
+  #endif 
+
+  #if MDEL<0
+    AudioConnection     patchCord1(acq,0, queue1,0);
+    AudioConnection     patchCord2(acq,1, queue1,1);
+    AudioConnection     patchCord3(acq,2, queue1,2);
+    AudioConnection     patchCord4(acq,3, queue1,3);
+  #else
+    #include "mProcess.h"
+    mProcess<NCH> process1(&snipParameters);
+
+    AudioConnection     patchCord1(acq,0, process1,0);
+    AudioConnection     patchCord2(acq,1, process1,1);
+    AudioConnection     patchCord3(acq,2, process1,2);
+    AudioConnection     patchCord4(acq,3, process1,3);
+    #if MDEL == 0
+      AudioConnection     patchCord5(acq,0, queue1,0);
+      AudioConnection     patchCord6(acq,1, queue1,1);
+      AudioConnection     patchCord7(acq,2, queue1,2);
+      AudioConnection     patchCord8(acq,3, queue1,3);
+    #else
+      AudioConnection     patchCord5(acq,0, delay1,0);
+      AudioConnection     patchCord6(acq,1, delay1,1);
+      AudioConnection     patchCord7(acq,2, delay1,2);
+      AudioConnection     patchCord8(acq,3, delay1,3);
+      AudioConnection     patchCord9(delay1,0, queue1,0);
+      AudioConnection     patchCord10(delay1,1, queue1,1);
+      AudioConnection     patchCord11(delay1,2, queue1,2);
+      AudioConnection     patchCord12(delay1,3, queue1,3);
+    #endif
+  #endif
 
   
 /*-------------------------- (multi channel TDM) -----------------------------*/
-#elif ACQ == _I2S_TDM       // not yet modified for event detections and delays
+#elif ACQ == _I2S_TDM
 
   #define NCH 5 // if changing number of channels adapt Audio connections  // NCH must be less or equal than 8
   
@@ -201,18 +240,47 @@
   
   #define MQ (MAX_Q/NCH)
   #include "m_queue.h"
-  mRecordQueue<MQ> queue[NCH];
+  mFrameQueue<NCH,MQ> queue1; // all channels in one frame queue
+
+  #if MDEL>0
+    #include "m_delay.h" 
+    mDelay<NCH>  delay1; // ring is sized in setup from snipParameters.ndel
+  #endif 
 
-  #if MDEL >=0
-    #undef MDEL
-    #define MDEL -1
+  #if MDEL<0
+    AudioConnection     patchCord0(acq,0,queue1,0);
+    AudioConnection     patchCord1(acq,1,queue1,1);
+    AudioConnection     patchCord2(acq,2,queue1,2);
+    AudioConnection     patchCord3(acq,3,queue1,3);
+    AudioConnection     patchCord4(acq,4,queue1,4);
+  #else
+    #include "mProcess.h"
+    mProcess<NCH> process1(&snipParameters);
+
+    AudioConnection     patchCord0(acq,0, process1,0);
+    AudioConnection     patchCord1(acq,1, process1,1);
+    AudioConnection     patchCord2(acq,2, process1,2);
+    AudioConnection     patchCord3(acq,3, process1,3);
+    AudioConnection     patchCord4(acq,4, process1,4);
+    #if MDEL == 0
+      AudioConnection     patchCord5(acq,0, queue1,0);
+      AudioConnection     patchCord6(acq,1, queue1,1);
+      AudioConnection     patchCord7(acq,2, queue1,2);
+      AudioConnection     patchCord8(acq,3, queue1,3);
+      AudioConnection     patchCord9(acq,4, queue1,4);
+    #else
+      AudioConnection     patchCord5(acq,0, delay1,0);
+      AudioConnection     patchCord6(acq,1, delay1,1);
+      AudioConnection     patchCord7(acq,2, delay1,2);
+      AudioConnection     patchCord8(acq,3, delay1,3);
+      AudioConnection     patchCord9(acq,4, delay1,4);
+      AudioConnection     patchCord10(delay1,0, queue1,0);
+      AudioConnection     patchCord11(delay1,1, queue1,1);
+      AudioConnection     patchCord12(delay1,2, queue1,2);
+      AudioConnection     patchCord13(delay1,3, queue1,3);
+      AudioConnection     patchCord14(delay1,4, queue1,4);
+    #endif
   #endif
-  
-  AudioConnection     patchCord0(acq,0,queue[0],0);
-  AudioConnection     patchCord1(acq,1,queue[1],0);
-  AudioConnection     patchCord2(acq,2,queue[2],0);
-  AudioConnection     patchCord3(acq,3,queue[3],0);
-  AudioConnection     patchCord4(acq,4,queue[4],0);
   //
 #elif ACQ == _I2S_SGTL5000  // to be tested
   #include "control_sgtl5000.h"
@@ -224,30 +292,30 @@
   #define NCH 2
   #define MQ (MAX_Q/NCH)
   #include "m_queue.h"
-  mRecordQueue<MQ> queue[NCH];
+  mFrameQueue<NCH,MQ> queue1; // all channels in one frame queue
 
   #if MDEL>0
     #include "m_delay.h" 
-    mDelay<NCH,(MDEL+2)>  delay1(2); // have two buffers more in queue only to be safe 
+    mDelay<NCH>  delay1; // ring is sized in setup from snipParameters.ndel
   #endif 
 
   #if MDEL<0
-    AudioConnection     patchCord3(acq,0, queue[0],0);
-    AudioConnection     patchCord4(acq,1, queue[1],0);
+    AudioConnection     patchCord3(acq,0, queue1,0);
+    AudioConnection     patchCord4(acq,1, queue1,1);
   #else
     #include "mProcess.h"
-    mProcess process1(&snipParameters);
+    mProcess<NCH> process1(&snipParameters);
 
     AudioConnection     patchCord1(acq,0, process1,0);
     AudioConnection     patchCord2(acq,1, process1,1);
     #if MDEL == 0
-      AudioConnection     patchCord3(acq,0, queue[0],0);
-      AudioConnection     patchCord4(acq,1, queue[1],0);
+      AudioConnection     patchCord3(acq,0, queue1,0);
+      AudioConnection     patchCord4(acq,1, queue1,1);
     #else
       AudioConnection     patchCord3(acq,0, delay1,0);
       AudioConnection     patchCord4(acq,1, delay1,1);
-      AudioConnection     patchCord5(delay1,0, queue[0],0);
-      AudioConnection     patchCord6(delay1,1, queue[1],0);
+      AudioConnection     patchCord5(delay1,0, queue1,0);
+      AudioConnection     patchCord6(delay1,1, queue1,1);
     #endif
   #endif
 
@@ -263,36 +331,61 @@
   #define NCH 2
   #define MQ (MAX_Q/NCH)
   #include "m_queue.h"
-  mRecordQueue<MQ> queue[NCH];
+  mFrameQueue<NCH,MQ> queue1; // all channels in one frame queue
 
   #if MDEL>0
     #include "m_delay.h" 
-    mDelay<NCH,(MDEL+2)>  delay1(2); // have two buffers more in queue only to be safe 
+    mDelay<NCH>  delay1; // ring is sized in setup from snipParameters.ndel
   #endif 
 
   #if MDEL<0
-    AudioConnection     patchCord3(acq,0, queue[0],0);
-    AudioConnection     patchCord4(acq,1, queue[1],0);
+    AudioConnection     patchCord3(acq,0, queue1,0);
+    AudioConnection     patchCord4(acq,1, queue1,1);
   #else
     #include "mProcess.h"
-    mProcess process1(&snipParameters);
+    mProcess<NCH> process1(&snipParameters);
 
     AudioConnection     patchCord1(acq,0, process1,0);
     AudioConnection     patchCord2(acq,1, process1,1);
     #if MDEL == 0
-      AudioConnection     patchCord3(acq,0, queue[0],0);
-      AudioConnection     patchCord4(acq,1, queue[1],0);
+      AudioConnection     patchCord3(acq,0, queue1,0);
+      AudioConnection     patchCord4(acq,1, queue1,1);
     #else
       AudioConnection     patchCord3(acq,0, delay1,0);
       AudioConnection     patchCord4(acq,1, delay1,1);
-      AudioConnection     patchCord5(delay1,0, queue[0],0);
-      AudioConnection     patchCord6(delay1,1, queue[1],0);
+      AudioConnection     patchCord5(delay1,0, queue1,0);
+      AudioConnection     patchCord6(delay1,1, queue1,1);
     #endif
   #endif
 #else
   #error "invalid acquisition device"
 #endif
 
+//==================== Audio memory budget ========================================
+// maximal number of audio blocks held by each node
+#if ACQ == _I2S_32_MONO
+  #define MB_ACQ 4                // I2S_32 fills left and right block, right is released after update
+#else
+  #define MB_ACQ (2*NCH)          // being filled by DMA and in transit to next node
+#endif
+#define MB_QUEUE (MQ*NCH)         // queued frames (MQ-1) and frame used by loop()
+#if MDEL>0
+  #define MB_DELAY ((MDEL+1)*NCH) // delay line (for default pre-trigger MDEL)
+  #define NDEL_MAX (MDEL+MQ/2)    // longer pre-trigger borrows from queue (at most half of it, queue1.setLimit in setup)
+#else
+  #define MB_DELAY 0
+  #define NDEL_MAX 0
+#endif
+#define MB_SPARE (MB_ACQ+4)       // a further acquisition update in flight and 4 blocks margin
+#define MAUDIO (MB_ACQ+MB_QUEUE+MB_DELAY+MB_SPARE)
+
+// ISR allocation failures (only counted by own acquisition objects)
+#if (ACQ == _I2S_32) || (ACQ == _I2S_32_MONO) || (ACQ == _I2S_TDM)
+  #define ACQ_ALLOC_FAIL ((int32_t)acq.allocFail)
+#else
+  #define ACQ_ALLOC_FAIL (-1)
+#endif
+
 //==================== Environmental sensors ========================================
 #if USE_ENVIRONMENTAL_SENSORS==1
   #include "enviro.h"
@@ -305,6 +398,58 @@
 #include "audio_hibernate.h"
 #include "m_menu.h"
 
+#if USE_LTSA>0
+  #include "m_ltsa.h"
+  mLtsa ltsa; // long-term spectral average of all acquired data (see snipParameters.ltsa)
+#endif
+
+#include "m_boot.h"
+mBoot boot; // boot-phase profile
+
+#include "m_power.h"
+mPower power; // CPU clock scaling and energy estimate
+
+// append power record of interval since last record (sleep: following hibernation in s)
+static void storePower(uint32_t sleep)
+{ PWR_Record_s rec;
+  power.getRecord(&rec, now(), sleep, F_SAMP, NCH, FAST_RESUME);
+  uSD.writePower(&rec, sizeof(rec));
+  power.resetStats();
+}
+
+#if MONITOR>0
+  #include "m_monitor.h"
+  mMonitor monitor; // decimated live data over USB serial
+#endif
+
+#if TELEMETRY>0
+  #include "m_telemetry.h"
+  mTelemetry telemetry; // binary status records
+  uint16_t telMissing[NCH]; // missing blocks per channel
+#endif
+
+#if MCLSF
+  #include "m_classifier.h"
+  mClassifier classifier; // second stage: gates storage of detections (see snipParameters.clsf)
+#endif
+
+#if MDET && (MSPILL>0)
+  #include "m_spill.h"
+  mSpill spill; // ring file on card with history of not stored data (see m_spill.h)
+  int16_t lookBuffer[AUDIO_BLOCK_SAMPLES*NCH];
+#endif
+
+#if MDET
+  mEventLog eventLog; // event records waiting to be written to disk
+  #define EVENT_FLUSH_AGE 600 // max time (s) event records are kept in RAM
+
+  // write pending event records (no data file open)
+  static void storeEvents(void)
+  { if(eventLog.getSize()>0) uSD.writeEvents(eventLog.getData(), eventLog.getSize());
+    eventLog.reset(now());
+  }
+#endif
+
 //---------------------------------- some utilities ------------------------------------
 
 // led only allowed if NO I2S
@@ -328,6 +473,30 @@ void ledOff(void)
 //extern void rtc_set(unsigned long t);
 
 time_t getTeensy3Time(){  return Teensy3Clock.get();}
+// RAM budget: audio blocks and larger application objects must leave RAM_SLACK (per MCU, see above)
+static const uint32_t appRam = sizeof(diskBuffer)
+#if USE_LTSA>0
+  + sizeof(ltsa)
+#endif
+#if MDET
+  + sizeof(process1)
+#endif
+#if MCLSF
+  + sizeof(classifier)
+#endif
+#if MDET && (MSPILL>0)
+  + sizeof(spill)
+#endif
+#if MONITOR>0
+  + sizeof(monitor)
+#endif
+#if TELEMETRY>0
+  + sizeof(telemetry)
+#endif
+  + ((MCDEL>0)? MCDEL + 2*AUDIO_BLOCK_SAMPLES*NCH*2: 0); // look-back ring, decode and hold buffers
+static_assert(MAUDIO*sizeof(audio_block_t) + appRam + RAM_SLACK <= RAM_SIZE,
+              "audio memory does not fit into RAM: reduce MAX_Q, MDEL or MCDEL");
+
 //__________________________General Arduino Routines_____________________________________
 //int started=0;
 extern "C" void setup() {
@@ -336,6 +505,7 @@ extern "C" void setup() {
 
   // set the Time library to use Teensy 3.0's RTC to keep time
   setSyncProvider(getTeensy3Time);
+  boot.begin(now(), RCM_SRS0);
 
 #if DO_DEBUG>0
    while(!Serial && !digitalRead(3));
@@ -353,8 +523,7 @@ extern "C" void setup() {
   temperature = -0.0293 * analogRead(70) + 440.5;
 */
 
-#define MAUDIO (MAX_Q+MDEL+50)
-	AudioMemory (MAUDIO); // 600 blocks use about 200 kB (requires Teensy 3.6)
+	AudioMemory (MAUDIO); // see audio memory budget
 
   // stop I2S early (to be sure)
   #if ((ACQ == _I2S) || (ACQ == _I2S_QUAD) || (ACQ == _I2S_32) || (ACQ == _I2S_32_MONO) || (ACQ == _I2S_TYMPAN) || (ACQ == _I2S_TDM))
@@ -372,16 +541,20 @@ extern "C" void setup() {
 //  if((t1-t0)>100) rtc_set(t1);
 
   //
+  boot.mark(BOOT_INIT);
   uSD.init();
+  boot.mark(BOOT_SD);
 
   // always load config first
-  uSD.loadConfig((uint32_t *)&acqParameters, 8, (int32_t *)&snipParameters, 8);
+  uSD.loadConfig(&acqParameters, &snipParameters);
+  boot.mark(BOOT_CONFIG);
 
 #if USE_ENVIRONMENTAL_SENSORS==1
    enviro_setup();
   // write temperature, pressure and humidity to SD card
    uSD.writeTemperature(temperature, pressure, humidity, lux);
 #endif
+  boot.mark(BOOT_ENVIRO);
 /*
   // if pin3 is connected to GND enter menu mode
   int ret;
@@ -390,7 +563,7 @@ extern "C" void setup() {
     if(ret<0) ;  // should shutdown now (not implemented) // keep compiler happy
       
     // should here save parameters to disk if modified
-    uSD.storeConfig((uint32_t *)&acqParameters, 8, (int32_t *)&snipParameters, 8);
+    uSD.storeConfig(&acqParameters, &snipParameters);
   }
 */
   // if pin3 is connected to GND enter menu mode
@@ -399,24 +572,37 @@ extern "C" void setup() {
   { ret=doMenu();
       
     // should here save parameters to disk if modified
-    uSD.storeConfig((uint32_t *)&acqParameters, 8, (int32_t *)&snipParameters, 8);
+    uSD.storeConfig(&acqParameters, &snipParameters);
 
     if(ret>0) 
-    setWakeupCallandSleep(ret*60);  // should shutdown now and wait for start
+    setWakeupCallandSleep(ret*60);  // should shutdown now and wait for start (continues here with FAST_RESUME)
+  }
+  boot.mark(BOOT_MENU);
+  // acquisition schedule: Schedule.txt on card, otherwise hour windows T1-T4
+  { char text[1024];
+    int32_t nbytes=uSD.readFile("Schedule.txt", text, sizeof(text));
+    if(schedule.parse(text, nbytes)) Serial.println("Schedule loaded");
+    else schedule.fromHours(acqParameters.T1, acqParameters.T2, acqParameters.T3, acqParameters.T4);
   }
   //
-  #if MDEL<0
+  #if (MDEL<0) || (ADAPT_DUTY>0)
     // check if it is our time to record
     int32_t nsec;
-    nsec=checkDutyCycle(&acqParameters, -1);
-    if(nsec>0) 
+    while((nsec=checkDutyCycle(&acqParameters, -1))>0) 
     { 
       #if ((ACQ == _I2S) || (ACQ == _I2S_QUAD) || (ACQ == _I2S_32) || (ACQ == _I2S_32_MONO) || (ACQ == _I2S_TYMPAN) || (ACQ == _I2S_TDM))
         I2S_stopClock();
       #endif
-      setWakeupCallandSleep(nsec); // will not return if we should not continue with acquisition 
+      #if MDET
+        storeEvents();
+      #endif
+      setWakeupCallandSleep(nsec); // will not return if we should not continue with acquisition (unless FAST_RESUME)
+      #if ((ACQ == _I2S) || (ACQ == _I2S_QUAD) || (ACQ == _I2S_32) || (ACQ == _I2S_32_MONO) || (ACQ == _I2S_TYMPAN) || (ACQ == _I2S_TDM))
+        I2S_startClock();
+      #endif
     }
   #endif
+  boot.mark(BOOT_SCHED);
   
   // Now modify objects from audio library
   #if (ACQ == _ADC_0) || (ACQ == _ADC_D) || (ACQ == _ADC_S)
@@ -462,11 +648,15 @@ extern "C" void setup() {
     int16_t nbits=NSHIFT; 
     acq.digitalShift(nbits); 
   #endif
+  boot.mark(BOOT_ACQ);
 
   //are we using the eventTrigger?
 //  if(snipParameters.thresh>=0) mustClose=0; else mustClose=-1;
   #if MDEL > 0
-    delay1.setDelay(MDEL);
+    if(snipParameters.ndel<0) snipParameters.ndel=0;
+    if(snipParameters.ndel>NDEL_MAX) snipParameters.ndel=NDEL_MAX;
+    if(!delay1.begin(snipParameters.ndel)) Serial.println("Delay allocation failed");
+    if(snipParameters.ndel>MDEL) queue1.setLimit(MQ-1-(snipParameters.ndel-MDEL)); // stay within MB_DELAY+MB_QUEUE
   #endif
   
   // set filename prefix
@@ -475,8 +665,35 @@ extern "C" void setup() {
   #if MDET
     process1.begin(&snipParameters); 
   #endif
+  #if MCLSF
+    // optional classifier model
+    if(classifier.begin(uSD.readFile("Model.bin", classifier.getBuffer(), CLS_MAXMODEL), F_SAMP))
+      Serial.println("Classifier model loaded");
+  #else
+    if(snipParameters.clsf>0) Serial.println("Classifier gate ignored (USE_CLASSIFIER 0)");
+  #endif
+
+  #if USE_LTSA>0
+    ltsa.begin(snipParameters.ltsa, F_SAMP);
+  #else
+    if(snipParameters.ltsa>0) Serial.println("LTSA ignored (USE_LTSA 0)");
+  #endif
+  #if MDET && (MSPILL>0)
+    if(!spill.begin(MSPILL, F_SAMP, acqParameters.name)) Serial.println("Spill file failed");
+  #endif
 
-  for(int ii=0; ii<NCH; ii++) queue[ii].begin();
+  queue1.begin();
+  #if TELEMETRY>0
+    telemetry.begin(acqParameters.name);
+  #endif
+  boot.mark(BOOT_PROC);
+  // the I2S MCLK is taken from the core clock at F_CPU 180 and 216 MHz (MCLK_SRC 0 in I2S_32.h, I2S_tdm.h and the Audio library)
+  #if ((ACQ == _I2S) || (ACQ == _I2S_QUAD) || (ACQ == _I2S_32) || (ACQ == _I2S_32_MONO) || (ACQ == _I2S_TYMPAN) || (ACQ == _I2S_TDM)) \
+      && ((F_CPU == 180000000) || (F_CPU == 216000000))
+    power.begin(0);
+  #else
+    power.begin(CPU_SCALING); // after all clock dividers are set (core may be at low clock from here)
+  #endif
   //
   Serial.println("End of Setup");
 //  started=0;  
@@ -488,6 +705,97 @@ extern "C" void setup() {
 volatile uint32_t maxValue=0, maxNoise=0; // possibly be updated outside
 int16_t tempBuffer[AUDIO_BLOCK_SAMPLES*NCH];
 
+#if MDET
+  char eventFile[32]; // first file of a storage run that was split by file size or duty cycle
+
+  // collect finished events and associate them with the just closed file (score: classifier, -1: none)
+  static void collectEvents(int16_t score)
+  { EVENT_Record_s event;
+    while(process1.getEvent(&event))
+    { strncpy(event.file, eventFile[0]? eventFile: uSD.getFilename(), sizeof(event.file)-1);
+      event.file[sizeof(event.file)-1]=0;
+      if(score>=0 && !(event.flags & EVENT_FLAG_NOISE))
+      { event.score=score;
+        if((snipParameters.clsf>0) && (score<snipParameters.clsf)) event.flags |= EVENT_FLAG_REJECT;
+      }
+      eventLog.add(&event);
+    }
+  }
+#endif
+
+#if MDET && (MCDEL>0)
+  #include "m_lookback.h"
+  mLookBack<NCH,MCDEL> lookBack; // compressed history of not stored data
+  int16_t lookBuffer[AUDIO_BLOCK_SAMPLES*NCH];
+  int16_t lookHold[AUDIO_BLOCK_SAMPLES*NCH]; // first live block, stored after the history
+  int16_t lookDrain=0; // history is being written
+#endif
+
+static uint32_t t3=1<<31,t4=0; // min and max disk write time
+static uint32_t t5,n5; // sum and number of disk writes
+
+// copy one multiplexed block to disk buffer and write buffer to disk when full
+static int16_t storeBlock(int16_t *tmp, int16_t state)
+{
+  uint32_t to,t1,t2;
+  // copy data to disk buffer
+  int16_t *ptr=(int16_t *) outptr;
+  
+  // number of data in tempBuffer
+  int32_t ndat = AUDIO_BLOCK_SAMPLES*NCH;
+  
+  // number of free samples on diskbuffer
+  int32_t nout = diskBuffer+BUFFERSIZE - outptr;
+
+  if (nout>ndat)
+  { // sufficient space for all data
+    for(int ii=0;ii<ndat;ii++) *ptr++ = *tmp++;
+    nout-=ndat;
+    ndat=0;
+  }
+  else
+  { // fill up disk buffer
+    int nbuf=nout;
+    if(uSD.isClosing()) nbuf=(nbuf/NCH)*NCH; // is last record of file 
+    for(int ii=0;ii<nbuf;ii++) *ptr++ = *tmp++;
+    ndat-=nbuf;
+    nout=0;
+  }
+  
+  if(nout==0) //buffer has been filled, so write to disk
+  { int32_t nbuf=ptr-diskBuffer;
+  
+    power.boost(); // SDIO clock follows the core clock (see m_power.h)
+    to=micros();
+    state=uSD.write(diskBuffer,nbuf); // this is blocking
+    t1=micros();
+    power.relax();
+    #if MDET
+      if(state==0)
+      { // file closed by size or duty cycle, storage continues in next file
+        collectEvents(-1);
+        if(!eventFile[0]) strncpy(eventFile, uSD.getFilename(), sizeof(eventFile)-1);
+      }
+    #endif
+    t2=t1-to;
+    if(t2<t3) t3=t2; // accumulate some time statistics
+    if(t2>t4) t4=t2;
+    t5+=t2; n5++;
+
+    ptr=(int16_t *)diskBuffer;
+  }
+
+  if(ndat>0) // save residual data
+  {
+    for(int ii=0;ii<ndat;ii++) *ptr++ = *tmp++;
+  }
+  
+  // all data are copied
+  outptr=(int16_t *)ptr; // save actual write position
+  power.addRecorded(AUDIO_BLOCK_SAMPLES);
+  return state;
+}
+
 // house keeping storaging activity
 #if MDEL<0
   int16_t mustStore=1;
@@ -497,17 +805,35 @@ int16_t tempBuffer[AUDIO_BLOCK_SAMPLES*NCH];
 
 extern "C" void loop() {
   // put your main code here, to run repeatedly:
-  uint32_t to=0,t1,t2;
-  static uint32_t t3,t4;
   static int16_t state=0; // 0: open new file, -1: last file
 
-  int have_data=1;
-  for(int ii=0;ii<NCH;ii++) if(queue[ii].available()==0) have_data=0;
+  power.update();
+  #if MDET
+    if(process1.isTdoaReady())
+    { power.boost();
+      process1.doTdoa(); // runs outside audio interrupt, only after trigger
+      power.relax();
+    }
+  #endif
+
+  #if MDET && (MCDEL>0)
+    if(lookDrain)
+    { // write history (oldest first) in steps of LOOK_COPY blocks, live frames wait in queue1
+      for(int ii=0; ii<LOOK_COPY && lookBack.pop(lookBuffer); ii++) state=storeBlock(lookBuffer, state);
+      if(!lookBack.available())
+      { state=storeBlock(lookHold, state);
+        lookDrain=0;
+      }
+      return;
+    }
+  #endif
+
+  int have_data = queue1.available()>0;
 
   if(have_data)
   { // have data on queue
 //    started=1; // flag that we have now data
-    #if MDEL<0
+    #if (MDEL<0) || (ADAPT_DUTY>0)
       int32_t nsec;
       nsec=checkDutyCycle(&acqParameters, state);
       if(nsec<0) { uSD.setClosing();} // this will be last record in file
@@ -519,24 +845,82 @@ extern "C" void loop() {
         #if DO_DEBUG>1
           logFile.close();
         #endif
+        #if USE_LTSA>0
+          uSD.writeLtsa(ltsa.getData(), ltsa.getSize()); // keep finished LTSA records
+          ltsa.reset();
+        #endif
+        #if MDET
+          storeEvents(); // RAM is lost in VLLS0
+        #endif
+        storePower(nsec);
+        #if TELEMETRY>0
+          telemetry.flush();
+        #endif
         setWakeupCallandSleep(nsec); // file closed sleep now
+        // FAST_RESUME: woke up with RAM and SD state intact, restart acquisition with fresh data
+        power.resync();
+        boot.resume(now()); // boot record of this wake-up is written with the first frame
+        #if ((ACQ == _I2S) || (ACQ == _I2S_QUAD) || (ACQ == _I2S_32) || (ACQ == _I2S_32_MONO) || (ACQ == _I2S_TYMPAN) || (ACQ == _I2S_TDM))
+          I2S_startClock();
+        #endif
+        boot.mark(BOOT_ACQ, power.getMHz());
+        #if DO_DEBUG>1
+          logFile.open("logFile.txt", O_CREAT | O_RDWR | O_APPEND);
+        #endif
+        queue1.clear();
+        return;
       } // nsec>0
       
     #endif
     //
-    // fetch data from queues
+    // fetch all channels of one frame from queue
     int16_t * data[NCH];
-    for(int ii=0; ii<NCH; ii++) data[ii] = (int16_t *)queue[ii].readBuffer();
+    int16_t ** frame = queue1.readFrame();
+    for(int ii=0; ii<NCH; ii++) data[ii] = frame[ii];
+    if(!boot.isDone())
+    { // first sample after boot: keep boot profile
+      boot.finish(power.getMHz());
+      uSD.writeBoot(boot.getRecord(), sizeof(BOOT_Record_s));
+      #if DO_DEBUG>0
+        boot.print();
+      #endif
+    }
     // multiplex data
     int16_t *tmp = tempBuffer;
-    for(int ii=0;ii<AUDIO_BLOCK_SAMPLES;ii++) for(int jj=0; jj<NCH; jj++) *tmp++ = *data[jj]++;
-    // release queues
-    for(int ii=0; ii<NCH; ii++) queue[ii].freeBuffer();
+    for(int ii=0;ii<AUDIO_BLOCK_SAMPLES;ii++) for(int jj=0; jj<NCH; jj++) *tmp++ = data[jj]? *data[jj]++: 0; // missing block: zeros
+    #if TELEMETRY>0
+      for(int jj=0; jj<NCH; jj++) if(!frame[jj]) telMissing[jj]++;
+    #endif
+    // release frame
+    queue1.freeFrame();
+
+    #if USE_LTSA>0
+      ltsa.add(tempBuffer, NCH, now()); // runs on all data, also when not stored
+      if(ltsa.mustFlush())
+      { uSD.writeLtsa(ltsa.getData(), ltsa.getSize());
+        ltsa.reset();
+      }
+    #endif
 
     #if(MDET)
       mustStore = process1.getSigCount() >  0;
+      #if ADAPT_DUTY>0
+        dutyActivity((process1.getSigCount()>0) && !process1.isNoise()); // periodic noise snippets are no activity
+      #endif
+      if(mustStore) uSD.setNoise(process1.isNoise());
+    #endif
+    #if MDET && (MCDEL>0)
+      if(!mustStore) lookBack.push(tempBuffer); // keep compressed history of data that are not stored
+    #endif
+    #if MDET && (MSPILL>0)
+      if(!mustStore && !spill.isCopying()) spill.write(tempBuffer); // keep history of data that are not stored on card
+      if(spill.isCopying()) mustStore=1; // finish promotion of history before closing file
     #endif
 
+    // file open and close (with classifier) run at full clock
+    int16_t heavy = (mustStore && (state==0)) || (!mustStore && (state>0));
+    if(heavy) power.boost();
+
     if(mustStore)
     {
       if(state==0)
@@ -567,58 +951,42 @@ extern "C" void loop() {
           for(int ii=0;ii<128;ii++) ptr[ii] = header[ii];
           outptr+=256; //(512 bytes)
         #endif
+        #if MCLSF
+          classifier.reset();
+        #endif
         state=1;
+        #if MDET && (MCDEL>0)
+          // compressed history goes first (written over the next loop passes), classifier features start after it
+          if(lookBack.available())
+          { memcpy(lookHold, tempBuffer, sizeof(lookHold));
+            lookDrain=1;
+          }
+        #endif
+        #if MDET && (MSPILL>0)
+          spill.startCopy(); // history is copied (oldest first) in front of live data
+        #endif
       } // state==0
-      
-      // copy data to disk buffer
-      int16_t *ptr=(int16_t *) outptr;
-      
-      // number of data in tempBuffer
-      int32_t ndat = AUDIO_BLOCK_SAMPLES*NCH;
-      
-      // number of free samples on diskbuffer
-      int32_t nout = diskBuffer+BUFFERSIZE - outptr;
-
-      tmp = tempBuffer;
-      if (nout>ndat)
-      { // sufficient space for all data
-        for(int ii=0;ii<ndat;ii++) *ptr++ = *tmp++;
-        nout-=ndat;
-        ndat=0;
-      }
-      else
-      { // fill up disk buffer
-        int nbuf=nout;
-        if(uSD.isClosing()) nbuf=(nbuf/NCH)*NCH; // is last record of file 
-        for(int ii=0;ii<nbuf;ii++) *ptr++ = *tmp++;
-        ndat-=nbuf;
-        nout=0;
-      }
-      
-      if(nout==0) //buffer has been filled, so write to disk
-      { int32_t nbuf=ptr-diskBuffer;
-      
-        to=micros();
-        state=uSD.write(diskBuffer,nbuf); // this is blocking
-        t1=micros();
-        t2=t1-to;
-        if(t2<t3) t3=t2; // accumulate some time statistics
-        if(t2>t4) t4=t2;
-
-        ptr=(int16_t *)diskBuffer;
-      }
 
-      if(ndat>0) // save residual data
-      {
-        for(int ii=0;ii<ndat;ii++) *ptr++ = *tmp++;
-      }
+      #if MCLSF
+        classifier.addBlock(tempBuffer, NCH); // features of stored data
+      #endif
       
-      // all data are copied
-      outptr=(int16_t *)ptr; // save actual write position
+      #if MDET && (MSPILL>0)
+        if(spill.isCopying())
+        { // live data go through ring until copy has caught up
+          spill.write(tempBuffer);
+          for(int ii=0; ii<SPILL_COPY && spill.read(lookBuffer); ii++) state=storeBlock(lookBuffer, state);
+        }
+        else
+      #endif
+      #if MDET && (MCDEL>0)
+        if(!lookDrain)
+      #endif
+      state=storeBlock(tempBuffer, state);
 
       if(!state)
       { // store config again if you wanted time of latest file stored
-        uSD.storeConfig((uint32_t *)&acqParameters, 8, (int32_t *)&snipParameters, 8);
+        uSD.storeConfig(&acqParameters, &snipParameters);
         #if DO_DEBUG>0
           Serial.println("closed");
         #endif
@@ -631,13 +999,107 @@ extern "C" void loop() {
       if(nbuf>0)
       { state=uSD.write(diskBuffer,nbuf); // this is blocking
       }
+      #if MCLSF
+        uint32_t cyc=ARM_DWT_CYCCNT;
+        int16_t score = classifier.score(); // -1 without model
+        cyc=ARM_DWT_CYCCNT-cyc;
+        uSD.setReject((snipParameters.clsf>0) && (score>=0) && (score<snipParameters.clsf));
+        #if DO_DEBUG>0
+          if(score>=0) Serial.printf("classifier score %d (%d cycles at %d MHz)\r\n", score, cyc, power.getMHz());
+        #endif
+      #elif MDET
+        int16_t score = -1; // no classifier
+      #endif
       state=uSD.close();
-      uSD.storeConfig((uint32_t *)&acqParameters, 8, (int32_t *)&snipParameters, 8);
+      uSD.storeConfig(&acqParameters, &snipParameters);
       outptr = diskBuffer;
+      #if MDET && (MSPILL>0)
+        spill.report(acqParameters.name); // SD bandwidth and wear statistics
+      #endif
+
+      #if MDET
+        collectEvents(score);
+        eventFile[0]=0;
+      #endif
     }
+    #if MDET
+      else if(eventLog.mustFlush(now(), EVENT_FLUSH_AGE))
+      { // no file is open: write event records
+        power.boost();
+        storeEvents();
+        power.relax();
+      }
+    #endif
+    // power record at a file close or while no file is open (as event records)
+    static uint32_t tPower=now();
+    if((state==0) && (now()-tPower >= PWR_INTERVAL))
+    { power.boost();
+      storePower(0);
+      power.relax();
+      tPower=now();
+    }
+    if(heavy) power.relax();
+    #if MONITOR>0
+      monitor.add(tempBuffer); // after storage: dropped if USB does not keep up
+    #endif
   }
+  #if MONITOR>0
+    monitor.service();
+  #endif
 
-#if DO_DEBUG>0
+#if TELEMETRY>0
+  // binary status record (replaces the text statistics)
+  static uint32_t telLoops=0;
+  static uint32_t telTime=0;
+  telLoops++;
+  if(millis()-telTime >= TELEMETRY*1000)
+  { telTime=millis();
+    TEL_Record_s rec;
+    memset(&rec, 0, sizeof(rec));
+    rec.nch=NCH;
+    rec.time=now();
+    rec.millis=millis();
+    rec.loops=telLoops;
+    rec.wrMin=n5? t3: 0xffffffff;
+    rec.wrMax=t4;
+    rec.wrMean=n5? t5/n5: 0;
+    rec.wrCount=n5;
+    rec.nbuf=uSD.getNbuf();
+    rec.audioMax=AudioMemoryUsageMax();
+    rec.queueMax=queue1.maxCount;
+    #if MDEL>0
+      rec.delayMax=delay1.maxCount;
+      delay1.maxCount=0;
+    #endif
+    rec.mhz=power.getMHz();
+    rec.drops=queue1.dropCount;
+    rec.allocFail=(uint32_t)ACQ_ALLOC_FAIL;
+    for(int ii=0; ii<NCH && ii<TEL_MAXCH; ii++) { rec.missing[ii]=telMissing[ii]; telMissing[ii]=0;}
+    #if MDET
+      rec.sigCount=process1.getSigCount();
+      rec.detCount=process1.getDetCount();
+      rec.threshold=process1.getThreshold();
+      process1.resetDetCount();
+    #endif
+    rec.maxValue=maxValue;
+    rec.maxNoise=maxNoise;
+    rec.fastPct=power.fastPercent();
+    rec.mWhh=(uint16_t)(10.0f*power.mWhPerHour(F_SAMP));
+    telemetry.add(&rec);
+    #if (TEL_OUT & 1) && (MONITOR>0)
+      monitor.addFrame(PROTO_TELEMETRY, &rec, sizeof(rec)); // between live data frames
+    #endif
+
+    AudioMemoryUsageMaxReset();
+    t3=1<<31; t4=0; t5=n5=0;
+    queue1.dropCount=0;
+    queue1.maxCount=0;
+    maxValue=0;
+    maxNoise=0;
+    telLoops=0;
+  }
+
+#elif DO_DEBUG>0
   // some statistics on progress
   static uint32_t loopCount=0;
   static uint32_t t0=0;
@@ -658,17 +1120,38 @@ extern "C" void loop() {
     AudioMemoryUsageMaxReset();
     t3=1<<31;
     t4=0;
+    t5=n5=0;
     
   #if MDET
-    Serial.printf(" | %4d; %10d %8d %8d; %4d %4d",
-            queue[0].dropCount, 
+    Serial.printf(" | %4d; %10d %8d %8d; %4d %4d; %5d; %6d cyc",
+            queue1.dropCount, 
             maxValue, maxNoise, maxValue/maxNoise,
-            process1.getSigCount(), process1.getDetCount());
+            process1.getSigCount(), process1.getDetCount(),
+            process1.getThreshold(), process1.getCycles());
             
-    queue[0].dropCount=0;
+    queue1.dropCount=0;
     process1.resetDetCount();
+    process1.resetCycles();
   #endif
 
+    // audio memory high-water marks (frames in queue, blocks in delay of MAUDIO) and ISR allocation failures
+    Serial.printf(" | %4d/%4d %4d %4d",
+            queue1.maxCount, queue1.getLimit(),
+          #if MDEL>0
+            delay1.maxCount,
+          #else
+            0,
+          #endif
+            ACQ_ALLOC_FAIL);
+    queue1.maxCount=0;
+  #if MDEL>0
+    delay1.maxCount=0;
+  #endif
+
+    // actual clock, time at full clock and estimated energy per hour of recorded data
+    Serial.printf(" | %3d MHz %3d%% %6.1f mWh/h",
+            power.getMHz(), (int)power.fastPercent(), power.mWhPerHour(F_SAMP));
+
   #if (ACQ==_ADC_0) | (ACQ==_ADC_D) | (ACQ==_ADC_S)
     Serial.printf("; %5d %5d",PDB0_CNT, PDB0_MOD);
   #endif
@@ -0,0 +1,104 @@
+#!/usr/bin/env python3
+#
+# Sound Recorder for Teensy 3.6
+# Copyright (c) 2018, Walter Zimmer
+#
+# host version of the band energy detector (iproc == 2, see m_bands.h and mProcess.h)
+# runs the detector on recorded wav files to tune bands and thresholds
+#
+# usage: bandDetector.py file.wav [file.wav ...]
+#
+# parameters are the same as in config.h (snipParameters and bandParameters)
+#
+import sys
+import wave
+import numpy as np
+
+NFFT = 128  # AUDIO_BLOCK_SAMPLES
+
+# snipParameters
+win0 = 1000     # noise estimation window (in units of audio blocks)
+win1 = 10000    # detection watchdog window
+extr = 38       # min extraction window
+inhib = 375     # guard window
+ndel = 0        # pre trigger delay
+nvote = 1       # number of channels that must detect
+
+# bandParameters: (f1, f2, thresh)
+bandParameters = [(1000, 4000, 100), (4000, 10000, 100), (10000, 20000, 100)]
+
+
+def loadWav(name):
+    with wave.open(name, 'rb') as w:
+        nch = w.getnchannels()
+        fsamp = w.getframerate()
+        data = np.frombuffer(w.readframes(w.getnframes()), dtype=np.int16)
+    return data.reshape(-1, nch), fsamp
+
+
+def bandBins(fsamp):
+    bins = []
+    for f1, f2, _ in bandParameters:
+        i1 = max(1, (f1 * NFFT) // fsamp)
+        i2 = min(NFFT // 2, (f2 * NFFT) // fsamp)
+        bins.append((i1, max(i1, i2)))
+    return bins
+
+
+def bandPower(data, fsamp):
+    # data: (nblocks*NFFT, nch); returns (nblocks, nch, nbands)
+    nblk = data.shape[0] // NFFT
+    x = data[:nblk * NFFT].reshape(nblk, NFFT, -1).astype(np.float64)
+    win = 0.5 - 0.5 * np.cos(2 * np.pi * np.arange(NFFT) / NFFT)
+    spec = np.fft.rfft(x * win[None, :, None], axis=1) / NFFT  # arm_rfft_q15 scales by 1/NFFT
+    pw = np.abs(spec) ** 2
+    out = np.zeros((nblk, x.shape[2], len(bandParameters)))
+    for jj, (i1, i2) in enumerate(bandBins(fsamp)):
+        out[:, :, jj] = pw[:, i1:i2 + 1, :].sum(axis=1)
+    return out
+
+
+def detect(pow):
+    nblk, nch, nb = pow.shape
+    thresh = np.array([t for _, _, t in bandParameters], dtype=np.float64)
+    use = thresh >= 0
+    nest = np.full((nch, nb), 4.0)  # as mProcess::begin (nband=1<<10 with 8 fractional bits)
+    sigCount = -1
+    events = []
+    start = None
+    for kk in range(nblk):
+        det = ((pow[kk] > thresh[None, :] * nest) & use[None, :]).any(axis=1)
+        if ((sigCount > 0) or (sigCount <= -inhib)) and det.sum() >= nvote:
+            if sigCount <= 0:
+                start = kk
+            sigCount = extr + ndel
+        sigCount -= 1
+        if sigCount < -inhib:
+            sigCount = -inhib
+        if sigCount == 0 and start is not None:
+            events.append((start, kk))
+            start = None
+        winx = win0 if sigCount < 0 else win1
+        nest += (pow[kk] - nest) / winx
+    if start is not None:
+        events.append((start, nblk))
+    return events
+
+
+def main(files):
+    for name in files:
+        data, fsamp = loadWav(name)
+        pow = bandPower(data, fsamp)
+        events = detect(pow)
+        print("%s: %d blocks, %d events" % (name, pow.shape[0], len(events)))
+        for k1, k2 in events:
+            bands = pow[k1:k2].max(axis=(0, 1))
+            print("  %10.3f s %8.3f s  band max: %s" % (k1 * NFFT / fsamp, (k2 - k1) * NFFT / fsamp,
+                  " ".join("%10.1f" % b for b in bands)))
+
+
+if __name__ == "__main__":
+    if len(sys.argv) < 2:
+        print("usage: bandDetector.py file.wav [file.wav ...]")
+        sys.exit(1)
+    main(sys.argv[1:])
@@ -0,0 +1,69 @@
+#!/usr/bin/env python3
+#
+# Sound Recorder for Teensy 3.6
+# Copyright (c) 2018, Walter Zimmer
+#
+# summarises boot profile files (Boot_<name>.bin, see m_boot.h)
+#
+# usage: boot.py Boot_WMXZ.bin [--csv boot.csv] [--last 20]
+#
+# prints mean and max duration (ms) of each setup phase, separately for
+# cold boots (power-on, watchdog, ...) and wake-ups from hibernation
+#
+import sys
+import argparse
+import time
+import numpy as np
+
+NAMES = ["reset", "init", "sd", "config", "enviro", "menu", "sched", "acq", "proc", "first"]
+NPHASE = len(NAMES)  # BOOT_NPHASE
+RECORD = np.dtype([('time', '<u4'), ('reset', 'u1'), ('nphase', 'u1'), ('mhz', '<u2'), ('us', '<u4', (NPHASE,))])
+RESET_WAKEUP = 0x01
+
+
+def load(name):
+    data = np.fromfile(name, dtype=RECORD)
+    data = data[data['nphase'] == NPHASE]
+    return data[np.argsort(data['time'], kind='stable')]
+
+
+def summary(data, label):
+    if len(data) == 0:
+        return
+    ms = data['us'] / 1000.0
+    total = ms.sum(axis=1)
+    print("%s: %d boots at %s MHz" % (label, len(data), ",".join(str(m) for m in np.unique(data['mhz']))))
+    print("  %-8s %10s %10s" % ("phase", "mean ms", "max ms"))
+    for ii, name in enumerate(NAMES):
+        print("  %-8s %10.1f %10.1f" % (name, ms[:, ii].mean(), ms[:, ii].max()))
+    print("  %-8s %10.1f %10.1f" % ("total", total.mean(), total.max()))
+
+
+def main():
+    parser = argparse.ArgumentParser(description="boot profile files of microSoundRecorder")
+    parser.add_argument('file')
+    parser.add_argument('--csv')
+    parser.add_argument('--last', type=int, help="only last boots")
+    args = parser.parse_args()
+
+    data = load(args.file)
+    if args.last:
+        data = data[-args.last:]
+    if len(data) == 0:
+        print("no records")
+        return 1
+    wake = (data['reset'] & RESET_WAKEUP) != 0
+    summary(data[~wake], "cold boot")
+    summary(data[wake], "wake-up")
+
+    if args.csv:
+        with open(args.csv, 'w') as f:
+            f.write("time,source,mhz," + ",".join(NAMES) + ",total\n")
+            for r in data:
+                f.write("%s,0x%02x,%d,%s,%d\n" % (time.strftime("%Y-%m-%d %H:%M:%S", time.gmtime(r['time'])),
+                        r['reset'], r['mhz'], ",".join(str(v) for v in r['us']), r['us'].sum()))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
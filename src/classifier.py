@@ -0,0 +1,317 @@
+#!/usr/bin/env python3
+#
+# Sound Recorder for Teensy 3.6
+# Copyright (c) 2018, Walter Zimmer
+#
+# host version of the second stage classifier (see m_classifier.h)
+# trains a small MLP on stored snippets, exports the int8 model file (Model.bin, copy to card)
+# and runs / benchmarks the same integer inference as the firmware
+#
+# usage:
+#   classifier.py train Model.bin other_dir target_dir [target2_dir ...] [--fsamp 48000] [--hidden 32]
+#   classifier.py eval  Model.bin other_dir target_dir [target2_dir ...]
+#   classifier.py score Model.bin file.wav [file.wav ...]
+#   classifier.py bench Model.bin
+#
+# class 0 (first directory) is "other", the score is the probability (percent) of not being class 0
+# features use the first nfrm*bpf blocks of channel 0 of each file, as the firmware does from file start
+# test/test_classifier.cpp runs the firmware code (m_classifier.h) on the host and compares it with this file;
+# the firmware prints the cycles of each inference with the debug output
+#
+import sys
+import os
+import time
+import struct
+import argparse
+import wave
+import numpy as np
+
+NFFT = 128          # AUDIO_BLOCK_SAMPLES
+VERSION = 1         # CLS_VERSION
+MAXMEL, MAXFRM, MAXHID, MAXMODEL = 32, 32, 128, 16384
+
+
+def log2q3(x):
+    # mLog2q3 (m_cfar.h) for an array of uint32
+    out = np.zeros(x.shape, dtype=np.int32)
+    for idx, v in np.ndenumerate(x):
+        v = int(v)
+        if v == 0:
+            continue
+        n = v.bit_length() - 1
+        f = ((v >> (n - 3)) if n >= 3 else (v << (3 - n))) & 7
+        out[idx] = (n << 3) | f
+    return out
+
+
+def melBins(nmel, fsamp, fmin=500.0):
+    # FFT bin edges of nmel mel spaced bands (each band at least one bin)
+    mel = lambda f: 2595.0 * np.log10(1.0 + f / 700.0)
+    imel = lambda m: 700.0 * (10.0 ** (m / 2595.0) - 1.0)
+    f = imel(np.linspace(mel(fmin), mel(fsamp / 2.0), nmel + 1))
+    bins = [max(1, int(round(x * NFFT / fsamp))) for x in f]
+    for ii in range(1, nmel + 1):
+        bins[ii] = max(bins[ii], bins[ii - 1] + 1)
+    if bins[-1] > NFFT // 2 + 1:
+        raise ValueError("too many mel bands for FFT size")
+    return bins
+
+
+def loadWav(name):
+    with wave.open(name, 'rb') as w:
+        nch = w.getnchannels()
+        fsamp = w.getframerate()
+        data = np.frombuffer(w.readframes(w.getnframes()), dtype=np.int16)
+    return data.reshape(-1, nch), fsamp
+
+
+def features(x, bins, nfrm, bpf, rnd=np.round):
+    # x: int16 samples of channel 0; returns int8 feature vector (frame major)
+    # rnd: rounding of the scaled spectrum (test/compare_classifier.py uses np.floor as the host FFT)
+    nmel = len(bins) - 1
+    nblk = nfrm * bpf
+    buf = np.zeros(nblk * NFFT, dtype=np.int16)
+    n = min(len(x), nblk * NFFT) // NFFT * NFFT  # only full blocks are stored
+    buf[:n] = x[:n]
+    # q15 window (arm_mult_q15) and 16 bit spectrum scaled by 1/NFFT (arm_rfft_q15), as in m_bands.h
+    win = (32767.0 * (0.5 - 0.5 * np.cos(2 * np.pi * np.arange(NFFT, dtype=np.float32) / NFFT))).astype(np.int16)
+    xw = (buf.astype(np.int32).reshape(nblk, NFFT) * win) >> 15
+    spec = np.fft.rfft(xw, axis=1) / NFFT
+    spec = rnd(spec.real) + 1j * rnd(spec.imag)
+    pw = spec.real ** 2 + spec.imag ** 2
+    band = np.stack([pw[:, bins[m]:bins[m + 1]].sum(axis=1) for m in range(nmel)], axis=1)
+    band = np.minimum(band, 0x7fffffff).astype(np.uint64)
+    acc = np.minimum(band.reshape(nfrm, bpf, nmel).sum(axis=1), 0xffffffff)
+    lg = log2q3(acc)
+    v = lg - int(lg.sum()) // lg.size
+    return np.clip(v, -128, 127).astype(np.int8).ravel()
+
+
+# ------------------------------ model file ------------------------------
+
+def writeModel(name, fsamp, bins, nfrm, bpf, layers):
+    nmel = len(bins) - 1
+    out = b'MCLS' + struct.pack('<6HI', VERSION, nmel, nfrm, bpf, len(layers), 0, fsamp)
+    out += struct.pack('<%dH' % (nmel + 1), *bins)
+    for ll, (W, b, shift, relu) in enumerate(layers):
+        if ll < len(layers) - 1 and not 0 <= shift <= 31:
+            raise ValueError("hidden layer shift %d, firmware accepts 0 .. 31" % shift)
+        out += struct.pack('<HHhH', W.shape[0], W.shape[1], shift, relu)
+        out += W.astype(np.int8).tobytes() + b.astype('<i4').tobytes()
+    if len(out) > MAXMODEL:
+        raise ValueError("model has %d bytes, firmware accepts %d" % (len(out), MAXMODEL))
+    with open(name, 'wb') as f:
+        f.write(out)
+    return len(out)
+
+
+def readModel(name):
+    data = open(name, 'rb').read()
+    if data[:4] != b'MCLS':
+        raise ValueError("not a model file")
+    version, nmel, nfrm, bpf, nlayer, _, fsamp = struct.unpack_from('<6HI', data, 4)
+    if version != VERSION:
+        raise ValueError("model version %d" % version)
+    ptr = 20
+    bins = list(struct.unpack_from('<%dH' % (nmel + 1), data, ptr))
+    ptr += 2 * (nmel + 1)
+    layers = []
+    for ll in range(nlayer):
+        nout, nin, shift, relu = struct.unpack_from('<HHhH', data, ptr)
+        if ll < nlayer - 1 and not 0 <= shift <= 31:
+            raise ValueError("hidden layer shift %d, firmware accepts 0 .. 31" % shift)
+        ptr += 8
+        W = np.frombuffer(data, dtype=np.int8, count=nout * nin, offset=ptr).reshape(nout, nin)
+        ptr += nout * nin
+        b = np.frombuffer(data, dtype='<i4', count=nout, offset=ptr)
+        ptr += 4 * nout
+        layers.append((W, b, shift, relu))
+    return dict(fsamp=fsamp, bins=bins, nfrm=nfrm, bpf=bpf, layers=layers)
+
+
+def infer(model, x):
+    # integer inference as in mClassifier::score(); returns score in percent
+    x = x.astype(np.int32)
+    layers = model['layers']
+    for ll, (W, b, shift, relu) in enumerate(layers):
+        acc = b.astype(np.int64) + W.astype(np.int64) @ x
+        if ll < len(layers) - 1:
+            acc = acc >> shift
+            if relu:
+                acc = np.maximum(acc, 0)
+            x = np.clip(acc, -128, 127)
+        else:
+            logit = acc.astype(np.float32) * np.float32(2.0 ** -shift)
+    if len(logit) == 1:
+        p = 1.0 / (1.0 + np.exp(-logit[0]))
+    else:
+        e = np.exp(logit - logit.max())
+        p = 1.0 - e[0] / e.sum()
+    return int(100.0 * p + 0.5)
+
+
+# ------------------------------ training ------------------------------
+
+def loadSet(dirs, bins, nfrm, bpf, fsamp):
+    X, y = [], []
+    for label, top in enumerate(dirs):
+        for root, _, files in os.walk(top):
+            for f in sorted(files):
+                if not f.lower().endswith('.wav'):
+                    continue
+                data, fs = loadWav(os.path.join(root, f))
+                if fs != fsamp:
+                    print("skip %s (%d Hz)" % (f, fs))
+                    continue
+                X.append(features(data[:, 0], bins, nfrm, bpf))
+                y.append(label)
+    return np.array(X), np.array(y)
+
+
+def trainMlp(X, y, nclass, nhid, epochs=2000, lr=0.01, seed=1):
+    # one hidden layer (ReLU) + softmax, Adam, full batch; inputs are int8 features scaled by 1/32
+    rng = np.random.default_rng(seed)
+    xs = X.astype(np.float64) / 32.0
+    W1 = rng.normal(size=(nhid, xs.shape[1])) * np.sqrt(2.0 / xs.shape[1])
+    b1 = np.zeros(nhid)
+    W2 = rng.normal(size=(nclass, nhid)) * np.sqrt(1.0 / nhid)
+    b2 = np.zeros(nclass)
+    params = [W1, b1, W2, b2]
+    m = [np.zeros_like(p) for p in params]
+    v = [np.zeros_like(p) for p in params]
+    Y = np.eye(nclass)[y]
+    for it in range(1, epochs + 1):
+        h = np.maximum(xs @ W1.T + b1, 0)
+        z = h @ W2.T + b2
+        z -= z.max(axis=1, keepdims=True)
+        p = np.exp(z)
+        p /= p.sum(axis=1, keepdims=True)
+        dz = (p - Y) / len(y)
+        dh = (dz @ W2) * (h > 0)
+        grads = [dh.T @ xs + 1e-4 * W1, dh.sum(axis=0), dz.T @ h + 1e-4 * W2, dz.sum(axis=0)]
+        for k in range(4):
+            m[k] = 0.9 * m[k] + 0.1 * grads[k]
+            v[k] = 0.999 * v[k] + 0.001 * grads[k] ** 2
+            params[k] -= lr * (m[k] / (1 - 0.9 ** it)) / (np.sqrt(v[k] / (1 - 0.999 ** it)) + 1e-8)
+    W1, b1, W2, b2 = params
+    return W1 / 32.0, b1, W2, b2, np.maximum(xs @ (W1.T) + b1, 0).max()
+
+
+def quantise(W1, b1, W2, b2, hmax):
+    # power of two scales; input features have exponent 0 (integer)
+    e1 = int(np.floor(np.log2(127.0 / np.abs(W1).max())))
+    eh = int(np.floor(np.log2(127.0 / max(hmax, 1e-6))))
+    shift1 = max(e1 - eh, 0)
+    eh = e1 - shift1
+    e2 = int(np.floor(np.log2(127.0 / np.abs(W2).max())))
+    W1q = np.clip(np.round(W1 * 2.0 ** e1), -128, 127)
+    b1q = np.round(b1 * 2.0 ** e1)
+    W2q = np.clip(np.round(W2 * 2.0 ** e2), -128, 127)
+    b2q = np.round(b2 * 2.0 ** (eh + e2))
+    return [(W1q, b1q, shift1, 1), (W2q, b2q, eh + e2, 0)]
+
+
+def train(args):
+    bins = melBins(args.nmel, args.fsamp)
+    X, y = loadSet(args.dirs, bins, args.nfrm, args.bpf, args.fsamp)
+    nclass = len(args.dirs)
+    if len(X) == 0 or len(set(y)) < 2:
+        print("need files of at least two classes")
+        sys.exit(1)
+    rng = np.random.default_rng(0)
+    idx = rng.permutation(len(y))
+    ntest = len(y) // 5
+    test, trn = idx[:ntest], idx[ntest:]
+    W1, b1, W2, b2, hmax = trainMlp(X[trn], y[trn], nclass, args.hidden)
+    layers = quantise(W1, b1, W2, b2, hmax)
+    nbytes = writeModel(args.model, args.fsamp, bins, args.nfrm, args.bpf, layers)
+    model = readModel(args.model)
+    h = np.maximum(X.astype(np.float64) @ W1.T + b1, 0)
+    fpred = np.argmax(h @ W2.T + b2, axis=1)
+    qscore = np.array([infer(model, x) for x in X])
+    print("%d files, %d classes, model %d bytes" % (len(y), nclass, nbytes))
+    for name, sel in (("train", trn), ("test", test)):
+        if len(sel) == 0:
+            continue
+        facc = np.mean((fpred[sel] != 0) == (y[sel] != 0))
+        qacc = np.mean((qscore[sel] >= 50) == (y[sel] != 0))
+        print("%5s: %4d files, target/other accuracy float %.3f, int8 %.3f" % (name, len(sel), facc, qacc))
+
+
+def evaluate(args):
+    model = readModel(args.model)
+    X, y = loadSet(args.dirs, model['bins'], model['nfrm'], model['bpf'], model['fsamp'])
+    score = np.array([infer(model, x) for x in X])
+    print("threshold  kept_other  kept_target")
+    for thr in (10, 25, 50, 75, 90):
+        keep = score >= thr
+        print("%9d  %10.3f  %11.3f" % (thr, keep[y == 0].mean() if np.any(y == 0) else 0,
+                                       keep[y != 0].mean() if np.any(y != 0) else 0))
+
+
+def score(args):
+    model = readModel(args.model)
+    for name in args.files:
+        data, fs = loadWav(name)
+        if fs != model['fsamp']:
+            print("%s: sampling frequency %d, model %d" % (name, fs, model['fsamp']))
+            continue
+        print("%s: %d" % (name, infer(model, features(data[:, 0], model['bins'], model['nfrm'], model['bpf']))))
+
+
+def bench(args):
+    model = readModel(args.model)
+    nmel = len(model['bins']) - 1
+    nin = nmel * model['nfrm']
+    rng = np.random.default_rng(0)
+    X = rng.integers(-60, 60, size=(args.n, nin)).astype(np.int8)
+    t0 = time.perf_counter()
+    for x in X:
+        infer(model, x)
+    dt = (time.perf_counter() - t0) / args.n
+    macs = sum(W.size for W, _, _, _ in model['layers'])
+    print("model: %d mel x %d frames (%d blocks/frame), layers %s, %d MAC" % (nmel, model['nfrm'], model['bpf'],
+          " ".join("%dx%d" % W.shape for W, _, _, _ in model['layers']), macs))
+    print("python: %.1f us per inference" % (dt * 1e6))
+    print("firmware code on the host: test/test_classifier Model.bin; on the Teensy: debug output after each file")
+
+
+def main():
+    parser = argparse.ArgumentParser(description="second stage classifier of microSoundRecorder")
+    sub = parser.add_subparsers(dest='cmd')
+    t = sub.add_parser('train')
+    t.add_argument('model')
+    t.add_argument('dirs', nargs='+', help="class directories, first is 'other'")
+    t.add_argument('--fsamp', type=int, default=48000)
+    t.add_argument('--nmel', type=int, default=16)
+    t.add_argument('--nfrm', type=int, default=16)
+    t.add_argument('--bpf', type=int, default=4, help="audio blocks per frame")
+    t.add_argument('--hidden', type=int, default=32)
+    e = sub.add_parser('eval')
+    e.add_argument('model')
+    e.add_argument('dirs', nargs='+')
+    s = sub.add_parser('score')
+    s.add_argument('model')
+    s.add_argument('files', nargs='+')
+    b = sub.add_parser('bench')
+    b.add_argument('model')
+    b.add_argument('--n', type=int, default=1000)
+    args = parser.parse_args()
+    if args.cmd == 'train':
+        if args.nmel > MAXMEL or args.nfrm > MAXFRM or args.hidden > MAXHID:
+            print("max %d mel bands, %d frames, %d hidden units" % (MAXMEL, MAXFRM, MAXHID))
+            sys.exit(1)
+        train(args)
+    elif args.cmd == 'eval':
+        evaluate(args)
+    elif args.cmd == 'score':
+        score(args)
+    elif args.cmd == 'bench':
+        bench(args)
+    else:
+        parser.print_help()
+        sys.exit(1)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,198 @@
+#!/usr/bin/env python3
+#
+# Sound Recorder for Teensy 3.6
+# Copyright (c) 2018, Walter Zimmer
+#
+# battery life and card fill planner
+#
+# usage: energy.py --config Config.txt --mah 20000 --card 128 [--boot Boot_WMXZ.bin] [--power Power_WMXZ.bin]
+#
+# the day is split into the firmware phases
+#   sleep:  hibernation (VLLS0, or LLS with FAST_RESUME) between duty cycles and outside T1-T4
+#   boot:   setup() after each wake-up (duration from Boot_<name>.bin, see m_boot.h)
+#   record: acquisition at F_CPU (and at the low clock with CPU_SCALING, see m_power.h)
+#   write:  extra SD current while writing the stored data
+# currents are board level estimates (PWR_MA0 + PWR_MA_MHZ * MHz of m_power.h);
+# measured sleep and SD currents of the actual board should be given with --sleep-ma and --sd-ma.
+# Power_<name>.bin (m_power.h) calibrates the fraction of time at F_CPU, the clocks
+# and, for the event detector, the fraction of stored data.
+#
+import sys
+import argparse
+import numpy as np
+
+PWR_MA0 = 12.0      # m_power.h
+PWR_MA_MHZ = 0.33
+SLEEP_MA = {0: 0.25, 1: 0.40}  # VLLS0, LLS (board incl. SD card in standby)
+BOOT_S = {0: 1.0, 1: 0.05}     # wake-up to first frame without boot records
+
+BOOT = np.dtype([('time', '<u4'), ('reset', 'u1'), ('nphase', 'u1'), ('mhz', '<u2'), ('us', '<u4', (10,))])
+POWER = np.dtype([('time', '<u4'), ('sleep', '<u4'), ('fastMs', '<u4'), ('slowMs', '<u4'), ('samples', '<u4'),
+                  ('fsamp', '<u4'), ('mhz', '<u2', (2,)), ('nch', 'u1'), ('mode', 'u1'), ('reserved', '<u2')])
+RESET_WAKEUP = 0x01
+ACQ = ["on", "ad", "ar", "T1", "T2", "T3", "T4", "rec"]
+SNIP = ["iproc", "thresh", "win0", "win1", "extr", "inhib", "nrep", "ndel", "nvote", "cfar", "nquant", "clsf", "ltsa"]
+
+
+def loadConfig(name):
+    # Config.txt as written by c_uSD::storeConfig (key=value, see m_config.h)
+    # or previous format (8 acq values, snip values, name; older files have fewer snip values)
+    with open(name) as f:
+        lines = [l.strip() for l in f if l.strip()]
+    if any(l.startswith("version=") for l in lines):
+        values = dict(l.split('=', 1) for l in lines if '=' in l and not l.startswith('#'))
+        acq = {k: int(values[k]) for k in ACQ if k in values}
+        snip = {k: int(values[k]) for k in SNIP if k in values}
+        return acq, snip
+    values = []
+    for l in lines:  # numbers until the name line (older files have fewer snip values)
+        try:
+            values.append(int(l))
+        except ValueError:
+            break
+    acq = dict(zip(ACQ, values[:len(ACQ)]))
+    snip = dict(zip(SNIP, values[len(ACQ):]))
+    return acq, snip
+
+
+def activeHours(T1, T2, T3, T4):
+    # same windows as mSchedule::fromHours
+    hours = 0
+    if T2 > T1:
+        hours += T2 - T1
+    if T4 > T3:
+        hours += T4 - T3
+    elif T4 < T1:
+        hours += 24 - T3 + T4
+    return min(hours, 24)
+
+
+def bootTime(name):
+    data = np.fromfile(name, dtype=BOOT)
+    data = data[data['nphase'] == 10]
+    wake = data[(data['reset'] & RESET_WAKEUP) != 0]
+    if len(wake) == 0:
+        wake = data
+    if len(wake) == 0:
+        return None
+    return wake['us'].sum(axis=1).mean() * 1e-6
+
+
+def powerStats(name):
+    data = np.fromfile(name, dtype=POWER)
+    if len(data) == 0:
+        return None
+    fast = data['fastMs'].sum() / 1000.0
+    slow = data['slowMs'].sum() / 1000.0
+    awake = fast + slow
+    if awake <= 0:
+        return None
+    last = data[-1]
+    return {'fast': fast / awake, 'stored': float((data['samples'] / data['fsamp']).sum()) / awake,
+            'mhz': int(last['mhz'][0]), 'low': int(last['mhz'][1]), 'fsamp': int(last['fsamp']),
+            'nch': int(last['nch']), 'mode': int(last['mode']), 'hours': awake / 3600.0}
+
+
+def main():
+    parser = argparse.ArgumentParser(description="battery life and card fill of microSoundRecorder deployments")
+    parser.add_argument('--config', help="Config.txt (acq and snip parameters)")
+    parser.add_argument('--acq', type=int, nargs=7, metavar=('on', 'ad', 'ar', 'T1', 'T2', 'T3', 'T4'),
+                        help="acq parameters (instead of --config)")
+    parser.add_argument('--fsamp', type=int, default=48000)
+    parser.add_argument('--nch', type=int, default=2)
+    parser.add_argument('--mhz', type=int, default=180, help="F_CPU in MHz")
+    parser.add_argument('--low', type=int, default=0, help="low clock in MHz (CPU_SCALING, 0: off)")
+    parser.add_argument('--fast', type=float, default=1.0, help="fraction of recording time at F_CPU")
+    parser.add_argument('--fast-resume', action='store_true', help="LLS instead of VLLS0 (FAST_RESUME)")
+    parser.add_argument('--sleep-ma', type=float, help="hibernation current (mA)")
+    parser.add_argument('--boot-s', type=float, help="wake-up duration (s)")
+    parser.add_argument('--sd-ma', type=float, default=50.0, help="extra current while writing (mA)")
+    parser.add_argument('--sd-mbs', type=float, default=4.0, help="write rate while writing (MB/s)")
+    parser.add_argument('--events', type=float, help="detections per hour (event detector, default cfar)")
+    parser.add_argument('--stored', type=float, help="fraction of recording time stored (overrides event estimate)")
+    parser.add_argument('--boot', help="Boot_<name>.bin for wake-up duration")
+    parser.add_argument('--power', help="Power_<name>.bin for clock residency and stored fraction")
+    parser.add_argument('--mah', type=float, default=20000.0, help="battery capacity (mAh at board supply)")
+    parser.add_argument('--derate', type=float, default=0.8, help="usable fraction of battery capacity")
+    parser.add_argument('--card', type=float, default=128.0, help="card size (GB)")
+    args = parser.parse_args()
+
+    acq = {'on': 300, 'ad': 300, 'ar': 3600, 'T1': 0, 'T2': 12, 'T3': 12, 'T4': 24}
+    snip = {'thresh': -1}
+    if args.config:
+        acq, snip = loadConfig(args.config)
+    if args.acq:
+        acq = dict(zip(ACQ, args.acq))
+
+    fsamp, nch, mhz, low, fast = args.fsamp, args.nch, args.mhz, args.low, args.fast
+    mode = 1 if args.fast_resume else 0
+    stored = args.stored
+    if args.power:
+        cal = powerStats(args.power)
+        if cal is None:
+            print("%s: no records" % args.power)
+        else:
+            print("calibration: %.1f h awake, %.0f%% at %d MHz (low %d MHz), %.1f%% stored"
+                  % (cal['hours'], 100 * cal['fast'], cal['mhz'], cal['low'], 100 * cal['stored']))
+            fsamp, nch, mhz, low, mode = cal['fsamp'], cal['nch'], cal['mhz'], cal['low'], cal['mode']
+            fast = cal['fast'] if low > 0 else 1.0
+            if stored is None:
+                stored = cal['stored']
+    bootS = args.boot_s if args.boot_s is not None else BOOT_S[mode]
+    if args.boot:
+        tb = bootTime(args.boot)
+        if tb is not None:
+            bootS = tb
+    sleepMA = args.sleep_ma if args.sleep_ma is not None else SLEEP_MA[mode]
+
+    # stored fraction of recording time
+    if stored is None:
+        if snip.get('thresh', -1) < 0:
+            stored = 1.0
+        else:
+            blocks = fsamp / 128.0
+            rate = args.events if args.events is not None else snip.get('cfar', 0)
+            evs = (snip.get('ndel', 0) + snip.get('extr', 0) + snip.get('inhib', 0)) / blocks
+            stored = min(1.0, rate * evs / 3600.0)
+            if snip.get('nrep', 0) > 0:
+                stored = min(1.0, stored + snip['extr'] / float(snip['nrep'] + snip['extr']))
+            if rate == 0:
+                print("event detector: no trigger rate (--events or cfar), only noise snippets counted")
+
+    # daily phase durations (s)
+    active = activeHours(acq['T1'], acq['T2'], acq['T3'], acq['T4']) * 3600.0
+    if acq['ar'] > acq['on']:
+        ncycle = active / acq['ar']
+        record = ncycle * acq['on']
+    else:
+        ncycle = 1.0 if active < 86400 else 0.0
+        record = active
+    boot = ncycle * bootS
+    sleep = max(0.0, 86400.0 - record - boot)
+
+    runMA = fast * (PWR_MA0 + PWR_MA_MHZ * mhz) + (1 - fast) * (PWR_MA0 + PWR_MA_MHZ * (low if low > 0 else mhz))
+    bootMA = PWR_MA0 + PWR_MA_MHZ * mhz
+    bytesDay = record * stored * fsamp * nch * 2
+    write = bytesDay / 1048576.0 / args.sd_mbs
+
+    mAs = {'sleep': sleep * sleepMA, 'boot': boot * bootMA, 'record': record * runMA, 'write': write * args.sd_ma}
+    mAhDay = sum(mAs.values()) / 3600.0
+
+    print("phases per day:")
+    print("  %-8s %10s %10s %10s" % ("phase", "h", "mA", "mAh"))
+    for name, dur, ma in [('sleep', sleep, sleepMA), ('boot', boot, bootMA), ('record', record, runMA),
+                          ('write', write, args.sd_ma)]:
+        print("  %-8s %10.2f %10.2f %10.1f" % (name, dur / 3600.0, ma, mAs[name] / 3600.0))
+    print("  %-8s %10s %10s %10.1f" % ("total", "", "", mAhDay))
+
+    battery = args.mah * args.derate / mAhDay if mAhDay > 0 else float('inf')
+    card = args.card * 1e9 / bytesDay if bytesDay > 0 else float('inf')
+    print("stored:  %.2f h/day, %.2f GB/day" % (record * stored / 3600.0, bytesDay / 1e9))
+    print("battery: %.1f days (%.0f mAh, %.0f%% usable)" % (battery, args.mah, 100 * args.derate))
+    print("card:    %.1f days (%.0f GB)" % (card, args.card))
+    print("runtime: %.1f days, limited by %s" % (min(battery, card), "battery" if battery <= card else "card"))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
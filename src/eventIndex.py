@@ -0,0 +1,114 @@
+#!/usr/bin/env python3
+#
+# Sound Recorder for Teensy 3.6
+# Copyright (c) 2018, Walter Zimmer
+#
+# builds and queries a sorted index of the event files (Events_<name>.bin, see m_events.h)
+# of many recorders
+#
+# usage:
+#   eventIndex.py build index.npy dir [dir ...]    # scan dirs recursively for Events_*.bin
+#   eventIndex.py query index.npy [--from 2024-05-01T00:00] [--to 2024-06-01T00:00]
+#                 [--recorder WMXZ] [--snr 20] [--chan 3] [--noise | --no-noise] [--fsamp 48000]
+#
+# query prints CSV: recorder,time,block,duration_s,chanMask,snr_dB,flags,file,score,tdoa1..tdoa7 (samples)
+# score is the classifier score in percent (empty if not classified)
+#
+import sys
+import os
+import argparse
+import calendar
+import time
+import numpy as np
+
+F_SAMP = 48000  # to convert block counts to seconds
+NBLOCK = 128    # AUDIO_BLOCK_SAMPLES
+
+# EVENT_Record_s (little endian, 64 bytes)
+RECORD = np.dtype([('time', '<u4'), ('block', '<u4'), ('duration', '<u2'), ('chanMask', '<u2'),
+                   ('snr', '<i2'), ('flags', '<u2'), ('file', 'S32'), ('tdoa', '<i2', (7,)), ('score', '<u2')])
+EVENT_FLAG_NOISE = 1
+EVENT_FLAG_REJECT = 2
+
+INDEX = np.dtype([('recorder', 'S8')] + RECORD.descr)
+
+
+def loadEvents(name):
+    data = np.fromfile(name, dtype=RECORD, count=os.path.getsize(name) // RECORD.itemsize)
+    recorder = os.path.basename(name)[len('Events_'):-len('.bin')]
+    out = np.empty(len(data), dtype=INDEX)
+    for key in RECORD.names:
+        out[key] = data[key]
+    out['recorder'] = recorder.encode()
+    return out
+
+
+def build(indexName, dirs):
+    parts = []
+    for top in dirs:
+        for root, _, files in os.walk(top):
+            for f in files:
+                if f.startswith('Events_') and f.endswith('.bin'):
+                    parts.append(loadEvents(os.path.join(root, f)))
+    index = np.concatenate(parts) if parts else np.empty(0, dtype=INDEX)
+    index = index[np.argsort(index, order=('time', 'recorder', 'block'), kind='stable')]
+    np.save(indexName, index)
+    print("%d events from %d files" % (len(index), len(parts)))
+
+
+def parseTime(text):
+    return calendar.timegm(time.strptime(text, "%Y-%m-%dT%H:%M"))
+
+
+def query(indexName, args):
+    index = np.load(indexName)
+    i1 = np.searchsorted(index['time'], parseTime(args.t1)) if args.t1 else 0
+    i2 = np.searchsorted(index['time'], parseTime(args.t2)) if args.t2 else len(index)
+    sel = index[i1:i2]
+    if args.recorder:
+        sel = sel[sel['recorder'] == args.recorder.encode()]
+    if args.snr is not None:
+        sel = sel[sel['snr'] * 3.0 / 8 >= args.snr]
+    if args.chan is not None:
+        sel = sel[(sel['chanMask'] & args.chan) != 0]
+    if args.noise is not None:
+        isNoise = (sel['flags'] & EVENT_FLAG_NOISE) != 0
+        sel = sel[isNoise == args.noise]
+    print("recorder,time,block,duration_s,chanMask,snr_dB,flags,file,score," + ",".join("tdoa%d" % k for k in range(1, 8)))
+    for ev in sel:
+        print("%s,%s,%d,%.3f,%d,%.1f,%d,%s,%s,%s" % (ev['recorder'].decode(),
+              time.strftime("%Y-%m-%dT%H:%M:%S", time.gmtime(int(ev['time']))),
+              ev['block'], ev['duration'] * NBLOCK / args.fsamp, ev['chanMask'],
+              ev['snr'] * 3.0 / 8, ev['flags'], ev['file'].decode(errors='replace'),
+              "" if ev['score'] == 0xffff else "%d" % ev['score'],
+              ",".join("%.2f" % (t / 16.0) for t in ev['tdoa'])))
+
+
+def main():
+    parser = argparse.ArgumentParser(description="event index of microSoundRecorder")
+    sub = parser.add_subparsers(dest='cmd')
+    b = sub.add_parser('build')
+    b.add_argument('index')
+    b.add_argument('dirs', nargs='+')
+    q = sub.add_parser('query')
+    q.add_argument('index')
+    q.add_argument('--from', dest='t1')
+    q.add_argument('--to', dest='t2')
+    q.add_argument('--recorder')
+    q.add_argument('--snr', type=float, help="min peak SNR in dB")
+    q.add_argument('--chan', type=int, help="channel mask (any of the bits)")
+    q.add_argument('--noise', dest='noise', action='store_true', default=None)
+    q.add_argument('--no-noise', dest='noise', action='store_false')
+    q.add_argument('--fsamp', type=int, default=F_SAMP, help="sampling frequency (to convert durations)")
+    args = parser.parse_args()
+    if args.cmd == 'build':
+        build(args.index, args.dirs)
+    elif args.cmd == 'query':
+        query(args.index, args)
+    else:
+        parser.print_help()
+        sys.exit(1)
+
+
+if __name__ == "__main__":
+    main()
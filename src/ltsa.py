@@ -0,0 +1,79 @@
+#!/usr/bin/env python3
+#
+# Sound Recorder for Teensy 3.6
+# Copyright (c) 2018, Walter Zimmer
+#
+# reads long-term spectral average files (LTSA_<name>.bin, see m_ltsa.h)
+#
+# usage: ltsa.py LTSA_WMXZ.bin [--fsamp 48000] [--png ltsa.png] [--csv ltsa.csv] [--hours 24]
+#
+# prints a summary; --png draws the spectrogram overview (needs matplotlib),
+# --csv writes time and band levels in dB (relative to full scale of the 16 bit spectrum)
+#
+import sys
+import argparse
+import time
+import numpy as np
+
+NBIN = 64  # LTSA_NBIN
+RECORD = np.dtype([('time', '<u4'), ('nblk', '<u2'), ('nbin', 'u1'), ('step', 'u1'), ('pow', 'u1', (NBIN,))])
+
+
+def load(name):
+    data = np.fromfile(name, dtype=RECORD)
+    return data[np.argsort(data['time'], kind='stable')]
+
+
+def toDb(pow):
+    # log2 with 3 fractional bits -> dB (mantissa is linear interpolation, as mLog2q3)
+    n = pow >> 3
+    f = (pow & 7) / 8.0
+    return 10.0 * np.log10((1.0 + f) * 2.0 ** n.astype(np.float64))
+
+
+def main():
+    parser = argparse.ArgumentParser(description="LTSA files of microSoundRecorder")
+    parser.add_argument('file')
+    parser.add_argument('--fsamp', type=int, default=48000)
+    parser.add_argument('--png')
+    parser.add_argument('--csv')
+    parser.add_argument('--hours', type=float, help="only last hours")
+    args = parser.parse_args()
+
+    data = load(args.file)
+    if len(data) == 0:
+        print("no records")
+        sys.exit(1)
+    if args.hours:
+        data = data[data['time'] >= data['time'][-1] - args.hours * 3600]
+    db = toDb(data['pow'])
+    freq = np.arange(1, NBIN + 1) * args.fsamp / (2.0 * NBIN)
+    t0, t1 = int(data['time'][0]), int(data['time'][-1])
+    dt = np.median(np.diff(data['time'])) if len(data) > 1 else 0
+    print("%d records, %s .. %s, interval %.0f s, %d blocks per record" % (len(data),
+          time.strftime("%Y-%m-%d %H:%M", time.gmtime(t0)), time.strftime("%Y-%m-%d %H:%M", time.gmtime(t1)),
+          dt, int(np.median(data['nblk']))))
+    gaps = np.nonzero(np.diff(data['time']) > 2 * dt)[0] if dt > 0 else []
+    print("%d gaps (hibernation or no acquisition)" % len(gaps))
+
+    if args.csv:
+        with open(args.csv, 'w') as f:
+            f.write("time," + ",".join("%.0f" % x for x in freq) + "\n")
+            for rec, row in zip(data, db):
+                f.write(time.strftime("%Y-%m-%dT%H:%M:%S", time.gmtime(int(rec['time']))) + "," +
+                        ",".join("%.1f" % x for x in row) + "\n")
+    if args.png:
+        import matplotlib
+        matplotlib.use('Agg')
+        import matplotlib.pyplot as plt
+        th = (data['time'] - t0) / 3600.0
+        plt.figure(figsize=(12, 4))
+        plt.pcolormesh(th, freq / 1000.0, db.T, shading='nearest')
+        plt.xlabel("hours since %s UTC" % time.strftime("%Y-%m-%d %H:%M", time.gmtime(t0)))
+        plt.ylabel("kHz")
+        plt.colorbar(label="dB")
+        plt.savefig(args.png, dpi=100, bbox_inches='tight')
+
+
+if __name__ == "__main__":
+    main()
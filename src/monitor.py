@@ -0,0 +1,118 @@
+#!/usr/bin/env python3
+#
+# Sound Recorder for Teensy 3.6
+# Copyright (c) 2018, Walter Zimmer
+#
+# live monitor of a recorder over USB serial (MONITOR in config.h, see m_monitor.h)
+#
+# usage: monitor.py PORT [--wav monitor.wav] [--seconds 60] [--play]
+#
+# prints once per second rms and peak level (dB re full scale) per channel and the dropped frames;
+# --wav writes the decimated data, --play plays them (needs sounddevice); needs pyserial
+#
+import sys
+import argparse
+import struct
+import time
+import wave
+import numpy as np
+import serial
+
+SYNC = b'\xa5\x5a'
+MONITOR = 0x10 | 0x80  # PROTO_MONITOR reply
+
+
+def crc16(data, crc=0xffff):
+    # CRC-16/CCITT-FALSE as protoCrc (m_proto.h)
+    for b in data:
+        crc ^= b << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else crc << 1
+        crc &= 0xffff
+    return crc
+
+
+def frames(ser):
+    # yields (seq, dropped, fsamp, data[nsamp, nch]); skips text output and corrupt frames
+    buf = b''
+    while True:
+        buf += ser.read(max(1, ser.in_waiting))
+        while True:
+            ii = buf.find(SYNC)
+            if ii < 0:
+                buf = buf[-1:]
+                break
+            buf = buf[ii:]
+            if len(buf) < 6:
+                break
+            n = struct.unpack('<H', buf[4:6])[0]
+            if len(buf) < 6 + n + 2:
+                break
+            body, crc = buf[2:6 + n], struct.unpack('<H', buf[6 + n:8 + n])[0]
+            if buf[3] != MONITOR or n < 17 or crc16(body) != crc:
+                buf = buf[2:]
+                continue
+            buf = buf[8 + n:]
+            seq, dropped, fsamp, nch, decim, nsamp = struct.unpack('<IIIBBH', body[5:21])
+            data = np.frombuffer(body[21:21 + 2 * nsamp * nch], dtype='<i2').reshape(nsamp, nch)
+            yield seq, dropped, fsamp, data
+
+
+def db(x):
+    return 20 * np.log10(np.maximum(x, 1) / 32768.0)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="live monitor of microSoundRecorder")
+    parser.add_argument('port')
+    parser.add_argument('--wav')
+    parser.add_argument('--seconds', type=float, help="stop after this duration")
+    parser.add_argument('--play', action='store_true')
+    args = parser.parse_args()
+
+    ser = serial.Serial(args.port, 115200, timeout=0.1)
+    wav = None
+    stream = None
+    acc = []
+    lastSeq = None
+    lost = 0
+    t0 = t1 = time.time()
+    try:
+        for seq, dropped, fsamp, data in frames(ser):
+            if lastSeq is not None and seq != lastSeq + 1:
+                lost += seq - lastSeq - 1  # includes frames dropped on device
+            lastSeq = seq
+            if args.wav and wav is None:
+                wav = wave.open(args.wav, 'wb')
+                wav.setnchannels(data.shape[1])
+                wav.setsampwidth(2)
+                wav.setframerate(fsamp)
+            if wav:
+                wav.writeframes(data.astype('<i2').tobytes())
+            if args.play:
+                if stream is None:
+                    import sounddevice
+                    stream = sounddevice.OutputStream(samplerate=fsamp, channels=data.shape[1], dtype='int16')
+                    stream.start()
+                stream.write(np.ascontiguousarray(data))
+            acc.append(data)
+            if time.time() - t1 >= 1.0:
+                t1 = time.time()
+                x = np.concatenate(acc).astype(float)
+                acc = []
+                rms = np.sqrt((x * x).mean(axis=0))
+                peak = np.abs(x).max(axis=0)
+                print("%s  %s  lost %d (device %d)" % (time.strftime("%H:%M:%S"),
+                      "  ".join("ch%d %6.1f %6.1f" % (ii, db(rms[ii]), db(peak[ii])) for ii in range(len(rms))),
+                      lost, dropped))
+            if args.seconds and time.time() - t0 > args.seconds:
+                break
+    except KeyboardInterrupt:
+        pass
+    if wav:
+        wav.close()
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
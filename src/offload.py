@@ -0,0 +1,143 @@
+#!/usr/bin/env python3
+#
+# Sound Recorder for Teensy 3.6
+# Copyright (c) 2018, Walter Zimmer
+#
+# data offload over the binary menu protocol (see m_proto.h); recorder must be in menu mode (pin 3 to GND)
+#
+# usage: offload.py PORT [--dest DIR] [--match '*.wav'] [--delete] [--list]
+#
+# copies all (matching) files of the card to DIR/<recorder name>/; files are received as <file>.part
+# in CRC checked chunks and renamed when complete, so an interrupted offload resumes where it stopped;
+# files that are already complete (same size) are skipped; --delete removes files on the card after
+# they have been received completely (and, for wav files, the header matches the size);
+# configuration files (KEEP) stay on the card; needs pyserial
+#
+import sys
+import os
+import argparse
+import fnmatch
+import struct
+import time
+from provision import Recorder
+
+LIST, READ, DELETE = 6, 7, 8
+RETRIES = 5
+KEEP = ["Config.txt", "Schedule.txt", "Model.bin"]  # inputs of the recorder, never deleted
+
+
+def listFiles(rec):
+    files = []
+    while True:
+        data = rec.command(LIST, struct.pack('<H', len(files)))
+        count = struct.unpack('<H', data[:2])[0]
+        if count == 0:
+            return files
+        pos = 2
+        for _ in range(count):
+            size, n = struct.unpack('<IB', data[pos:pos + 5])
+            files.append((data[pos + 5:pos + 5 + n].decode(errors='replace'), size))
+            pos += 5 + n
+
+
+def abort(rec):
+    # any byte stops the stream on the device; drop what is still in transit
+    rec.ser.write(b'\0')
+    time.sleep(0.3)
+    rec.ser.reset_input_buffer()
+
+
+def receive(rec, name, size, path):
+    # returns number of bytes received in this session
+    part = path + ".part"
+    offset = os.path.getsize(part) if os.path.exists(part) else 0
+    if offset > size:
+        offset = 0
+    got = 0
+    with open(part, 'r+b' if offset else 'wb') as f:
+        f.seek(offset)
+        f.truncate()
+        for retry in range(RETRIES):
+            rec.send(READ, struct.pack('<I', offset) + name.encode())
+            try:
+                while True:
+                    data = rec.reply(READ)
+                    pos = struct.unpack('<I', data[:4])[0]
+                    if len(data) == 4:  # end of file
+                        if pos != offset or offset != size:
+                            raise IOError("size mismatch")
+                        break
+                    if pos != offset:
+                        raise IOError("chunk at %d, expected %d" % (pos, offset))
+                    f.write(data[4:])
+                    offset += len(data) - 4
+                    got += len(data) - 4
+                break
+            except IOError as e:
+                f.flush()
+                print("  %s at %d: %s, resuming" % (name, offset, e))
+                abort(rec)
+        else:
+            raise IOError("%s: giving up after %d retries" % (name, RETRIES))
+    os.replace(part, path)
+    return got
+
+
+def wavOk(path):
+    # RIFF and data chunk sizes as written by wavHeader()
+    with open(path, 'rb') as f:
+        hdr = f.read(44)
+    if len(hdr) < 44 or hdr[:4] != b'RIFF':
+        return True  # raw files and side files have no header to check
+    size = os.path.getsize(path)
+    return struct.unpack('<I', hdr[4:8])[0] == size - 8 and struct.unpack('<I', hdr[40:44])[0] == size - 44
+
+
+def main():
+    parser = argparse.ArgumentParser(description="data offload of microSoundRecorder")
+    parser.add_argument('port')
+    parser.add_argument('--dest', default='.')
+    parser.add_argument('--match', default='*')
+    parser.add_argument('--delete', action='store_true', help="delete files on card after complete transfer")
+    parser.add_argument('--list', action='store_true', help="only list files")
+    args = parser.parse_args()
+
+    rec = Recorder(args.port)
+    name = rec.getStatus()["name"]
+    files = [f for f in listFiles(rec) if fnmatch.fnmatch(f[0], args.match)]
+    total = sum(f[1] for f in files)
+    print("%s: %d files, %.1f MB" % (name, len(files), total / 1048576.0))
+    if args.list:
+        for fname, size in files:
+            print("  %10d %s" % (size, fname))
+        return 0
+
+    dest = os.path.join(args.dest, name)
+    os.makedirs(dest, exist_ok=True)
+    nbytes = 0
+    nfail = 0
+    t0 = time.time()
+    for fname, size in files:
+        path = os.path.join(dest, fname)
+        try:
+            if os.path.exists(path) and os.path.getsize(path) == size:
+                status = "skipped"
+            else:
+                nbytes += receive(rec, fname, size, path)
+                status = "ok"
+            if not wavOk(path):
+                raise IOError("wav header does not match size")
+            if args.delete and fname not in KEEP:
+                rec.command(DELETE, fname.encode())
+                status += ", deleted"
+            print("  %10d %s %s" % (size, fname, status))
+        except IOError as e:
+            nfail += 1
+            print("  %10d %s failed: %s" % (size, fname, e))
+    dt = time.time() - t0
+    print("%.1f MB in %.1f s (%.2f MB/s), %d failed" % (nbytes / 1048576.0, dt, nbytes / 1048576.0 / max(dt, 1e-3), nfail))
+    return 1 if nfail else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,204 @@
+#!/usr/bin/env python3
+#
+# Sound Recorder for Teensy 3.6
+# Copyright (c) 2018, Walter Zimmer
+#
+# batch provisioning over the binary menu protocol (see m_proto.h); recorders must be in menu mode (pin 3 to GND)
+#
+# usage: provision.py PORT [PORT ...] status
+#        provision.py PORT [PORT ...] get [--json params.json]
+#        provision.py PORT [PORT ...] set [--json params.json] [on=300 ar=3600 thresh=100 ...] [--names WM01,WM02]
+#        provision.py PORT [PORT ...] time
+#        provision.py PORT [PORT ...] exit [--minutes -1]
+#
+# all ports are served in parallel; set writes, reads back and verifies the parameters,
+# time sets the RTC to the host clock (UTC); needs pyserial
+#
+import sys
+import argparse
+import json
+import struct
+import time
+from concurrent.futures import ThreadPoolExecutor
+import serial
+
+SYNC = b'\xa5\x5a'
+VERSION = 1  # PROTO_VERSION
+STATUS, GET, SET, RTC, EXIT = 1, 2, 3, 4, 5
+ERRORS = {1: "crc error", 2: "protocol version", 3: "unknown command", 4: "wrong length", 5: "file error"}
+
+ACQ = ["on", "ad", "ar", "T1", "T2", "T3", "T4", "rec"]
+SNIP = ["iproc", "thresh", "win0", "win1", "extr", "inhib", "nrep", "ndel", "nvote", "cfar", "nquant", "clsf", "ltsa"]
+STATUSFMT = '<HHHBBIiII8s'
+
+
+def crc16(data, crc=0xffff):
+    # CRC-16/CCITT-FALSE as protoCrc
+    for b in data:
+        crc ^= b << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else crc << 1
+        crc &= 0xffff
+    return crc
+
+
+class Recorder:
+    def __init__(self, port, timeout=1.0):
+        self.port = port
+        self.ser = serial.Serial(port, 115200, timeout=timeout)
+        self.ser.reset_input_buffer()
+        self.status = None
+
+    def send(self, cmd, payload=b''):
+        body = struct.pack('<BBH', VERSION, cmd, len(payload)) + payload
+        self.ser.write(SYNC + body + struct.pack('<H', crc16(body)))
+
+    def reply(self, cmd):
+        # skip text output of the menu up to the reply frame
+        buf = b''
+        t0 = time.time()
+        while not buf.endswith(SYNC):
+            c = self.ser.read(1)
+            if not c or time.time() - t0 > 5:
+                raise IOError("no reply")
+            buf = buf[-1:] + c
+        hdr = self.ser.read(4)
+        if len(hdr) != 4:
+            raise IOError("short reply")
+        version, rcmd, n = struct.unpack('<BBH', hdr)
+        data = self.ser.read(n)
+        crc = self.ser.read(2)
+        if len(data) != n or len(crc) != 2 or crc16(hdr + data) != struct.unpack('<H', crc)[0]:
+            raise IOError("reply crc error")
+        if rcmd != (cmd | 0x80):
+            raise IOError("reply to command 0x%02x" % rcmd)
+        if data[0] != 0:
+            raise IOError("%s (device protocol %d)" % (ERRORS.get(data[0], "error %d" % data[0]), version))
+        return data[1:]
+
+    def command(self, cmd, payload=b''):
+        self.send(cmd, payload)
+        return self.reply(cmd)
+
+    def getStatus(self):
+        v = struct.unpack(STATUSFMT, self.command(STATUS))
+        self.status = dict(zip(["version", "nacq", "nsnip", "nch", "acq", "fsamp", "mdel", "time", "millis"], v[:9]))
+        self.status["name"] = v[9].split(b'\0')[0].decode(errors='replace')
+        return self.status
+
+    def unpack(self, data):
+        nacq, nsnip = self.status["nacq"], self.status["nsnip"]
+        acq = struct.unpack('<%dI' % (len(ACQ)), data[:4 * len(ACQ)])
+        params = dict(zip(ACQ, acq))
+        params["name"] = data[4 * len(ACQ):nacq].split(b'\0')[0].decode(errors='replace')
+        snip = struct.unpack('<%di' % (nsnip // 4), data[nacq:nacq + nsnip])
+        params.update(zip(SNIP, snip))
+        return params
+
+    def pack(self, params):
+        nacq, nsnip = self.status["nacq"], self.status["nsnip"]
+        data = struct.pack('<%dI' % len(ACQ), *[params[k] for k in ACQ])
+        data += params["name"].encode()[:nacq - len(data) - 1].ljust(nacq - len(data), b'\0')
+        data += struct.pack('<%di' % (nsnip // 4), *[params[k] for k in SNIP[:nsnip // 4]])
+        return data
+
+    def getParams(self):
+        if self.status is None:
+            self.getStatus()
+        return self.unpack(self.command(GET))
+
+    def setParams(self, params):
+        if self.status is None:
+            self.getStatus()
+        return self.unpack(self.command(SET, self.pack(params)))
+
+    def setTime(self, tt):
+        self.command(RTC, struct.pack('<I', tt))
+
+    def exit(self, minutes):
+        self.command(EXIT, struct.pack('<i', minutes))
+
+
+def parseValues(items):
+    values = {}
+    for item in items:
+        key, val = item.split('=', 1)
+        if key not in ACQ + SNIP + ["name"]:
+            raise ValueError("unknown parameter %s" % key)
+        values[key] = val if key == "name" else int(val)
+    return values
+
+
+def run(port, args, values, name):
+    rec = Recorder(port)
+    if args.cmd == "status":
+        st = rec.getStatus()
+        return "%s: %s fsamp %d nch %d mdel %d rtc %s (host %+d s)" % (
+            port, st["name"], st["fsamp"], st["nch"], st["mdel"],
+            time.strftime("%Y-%m-%d %H:%M:%S", time.gmtime(st["time"])), st["time"] - int(time.time()))
+    if args.cmd == "get":
+        params = rec.getParams()
+        if args.json:
+            with open(args.json if len(args.ports) == 1 else "%s_%s" % (params["name"], args.json), 'w') as f:
+                json.dump(params, f, indent=1)
+        return "%s: %s" % (port, " ".join("%s=%s" % kv for kv in params.items()))
+    if args.cmd == "set":
+        params = rec.getParams()
+        params.update(values)
+        if name:
+            params["name"] = name
+        used = rec.setParams(params)
+        diff = [k for k in params if k != "rec" and params[k] != used[k]]
+        if diff:
+            return "%s: set, changed by range check: %s" % (
+                port, " ".join("%s=%s" % (k, used[k]) for k in diff))
+        return "%s: set %s" % (port, used["name"])
+    if args.cmd == "time":
+        rec.setTime(int(time.time()))
+        return "%s: rtc set" % port
+    if args.cmd == "exit":
+        rec.exit(args.minutes)
+        return "%s: exit %d" % (port, args.minutes)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="provisioning of microSoundRecorders in menu mode")
+    parser.add_argument('ports', nargs='+', help="serial ports followed by command (status, get, set, time, exit)")
+    parser.add_argument('--json', help="parameter file (get: write, set: read)")
+    parser.add_argument('--names', help="comma separated recorder names, one per port")
+    parser.add_argument('--minutes', type=int, default=-1, help="exit: minutes to hibernate (-1: start now)")
+    args = parser.parse_args()
+
+    # split ports, command and key=value settings
+    cmds = ["status", "get", "set", "time", "exit"]
+    idx = [ii for ii, a in enumerate(args.ports) if a in cmds]
+    if not idx:
+        parser.error("missing command")
+    args.cmd = args.ports[idx[0]]
+    items = args.ports[idx[0] + 1:]
+    args.ports = args.ports[:idx[0]]
+    values = {}
+    if args.json and args.cmd == "set":
+        with open(args.json) as f:
+            values = {k: v for k, v in json.load(f).items() if k != "rec"}
+    values.update(parseValues(items))
+    names = args.names.split(',') if args.names else [None] * len(args.ports)
+    if len(names) != len(args.ports):
+        parser.error("need one name per port")
+
+    def task(pn):
+        try:
+            return True, run(pn[0], args, values, pn[1])
+        except (IOError, serial.SerialException) as e:
+            return False, "%s: %s" % (pn[0], e)
+
+    nfail = 0
+    with ThreadPoolExecutor(max_workers=len(args.ports)) as pool:
+        for ok, text in pool.map(task, zip(args.ports, names)):
+            print(text)
+            nfail += not ok
+    return 1 if nfail else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
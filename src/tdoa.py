@@ -0,0 +1,101 @@
+#!/usr/bin/env python3
+#
+# Sound Recorder for Teensy 3.6
+# Copyright (c) 2018, Walter Zimmer
+#
+# host version of the GCC-PHAT time difference of arrival estimator (see m_tdoa.h)
+#
+# usage:
+#   tdoa.py sim [--snr 10]                      # check estimator with simulated delays
+#   tdoa.py file.wav start_s [start_s ...]       # estimate delays at given times of a recording
+#
+# delays are printed in samples (channel k relative to channel 0, positive: channel k is later)
+#
+import sys
+import wave
+import numpy as np
+
+NBLOCK = 128            # AUDIO_BLOCK_SAMPLES
+NTDOA = 2 * NBLOCK      # samples per channel
+NTFFT = 2 * NTDOA       # zero padded FFT length
+MAXLAG = 64             # TDOA_MAXLAG
+
+
+def gccPhat(data):
+    # data: (NTDOA, nch) int16; returns delays of channels 1..nch-1 in units of 1/16 sample (as firmware)
+    x = np.zeros((NTFFT, data.shape[1]))
+    x[:NTDOA] = data[:NTDOA]
+    X = np.fft.rfft(x, axis=0).astype(np.complex64)
+    out = []
+    for kk in range(1, data.shape[1]):
+        G = X[:, kk] * np.conj(X[:, 0])
+        G[1:-1] /= np.abs(G[1:-1]) + 1e-20
+        G[0] = np.sign(G[0].real) if G[0].real != 0 else 1.0    # DC and Nyquist are real (packed format)
+        G[-1] = np.sign(G[-1].real) if G[-1].real != 0 else 1.0
+        r = np.fft.irfft(G, NTFFT)
+        lags = np.arange(-MAXLAG, MAXLAG + 1)
+        vals = r[lags % NTFFT]
+        ii = int(np.argmax(vals))
+        imax = lags[ii]
+        vmax = r[imax % NTFFT]
+        ym, yp = r[(imax - 1) % NTFFT], r[(imax + 1) % NTFFT]
+        den = ym - 2 * vmax + yp
+        dl = 0.5 * (ym - yp) / den if den < 0 else 0.0
+        out.append(int(np.rint((imax + dl) * 16)))
+    return out
+
+
+def fracDelay(x, d):
+    # delay x by d samples (may be fractional) using frequency domain phase shift
+    n = len(x)
+    X = np.fft.rfft(x, 2 * n)
+    f = np.arange(len(X)) / (2 * n)
+    return np.fft.irfft(X * np.exp(-2j * np.pi * f * d), 2 * n)[:n]
+
+
+def simulate(snr, nch=4, ntrial=200):
+    rng = np.random.default_rng(1)
+    err = []
+    for _ in range(ntrial):
+        delays = np.concatenate(([0.0], rng.uniform(-MAXLAG / 2, MAXLAG / 2, nch - 1)))
+        # broadband click with decaying tail
+        src = rng.normal(size=NTDOA) * np.exp(-np.arange(NTDOA) / 40.0)
+        src = np.roll(src, NTDOA // 4)
+        data = np.zeros((NTDOA, nch))
+        for kk in range(nch):
+            sig = fracDelay(src, delays[kk])
+            noise = rng.normal(size=NTDOA) * np.std(sig) * 10 ** (-snr / 20)
+            data[:, kk] = sig + noise
+        data = np.round(data / np.abs(data).max() * 16000).astype(np.int16)
+        est = np.array(gccPhat(data)) / 16.0
+        err.append(est - delays[1:])
+    err = np.abs(np.concatenate(err))
+    print("snr %5.1f dB: median error %.3f samples, 95%% %.3f samples, outliers (>1 sample) %.1f %%"
+          % (snr, np.median(err), np.percentile(err, 95), 100.0 * np.mean(err > 1)))
+
+
+def fromWav(name, starts):
+    with wave.open(name, 'rb') as w:
+        nch = w.getnchannels()
+        fsamp = w.getframerate()
+        data = np.frombuffer(w.readframes(w.getnframes()), dtype=np.int16).reshape(-1, nch)
+    for t in starts:
+        i0 = int(float(t) * fsamp)
+        res = gccPhat(data[i0:i0 + NTDOA])
+        print("%10.3f s: %s" % (float(t), " ".join("%7.2f" % (r / 16.0) for r in res)))
+
+
+def main():
+    if len(sys.argv) < 2:
+        print("usage: tdoa.py sim [--snr 10] | tdoa.py file.wav start_s [start_s ...]")
+        sys.exit(1)
+    if sys.argv[1] == 'sim':
+        snrs = [float(sys.argv[3])] if len(sys.argv) > 3 and sys.argv[2] == '--snr' else [0, 10, 20, 30]
+        for snr in snrs:
+            simulate(snr)
+    else:
+        fromWav(sys.argv[1], sys.argv[2:])
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,166 @@
+#!/usr/bin/env python3
+#
+# Sound Recorder for Teensy 3.6
+# Copyright (c) 2018, Walter Zimmer
+#
+# decodes binary status records (TELEMETRY in config.h, see m_telemetry.h)
+#
+# usage: telemetry.py Telemetry_WMXZ.bin [--csv telemetry.csv] [--png telemetry.png]
+#        telemetry.py --port /dev/ttyACM0 [--csv telemetry.csv] [--seconds 600]
+#
+# the ring file is ordered by record number; from the serial port records are printed as they arrive
+# (needs pyserial); --png plots write latency, audio memory, drops and detector levels (needs matplotlib)
+#
+import sys
+import argparse
+import struct
+import time
+import numpy as np
+
+MAXCH = 8  # TEL_MAXCH
+RECORD = np.dtype([('size', '<u2'), ('version', 'u1'), ('nch', 'u1'), ('seq', '<u4'), ('time', '<u4'),
+                   ('millis', '<u4'), ('loops', '<u4'), ('wrMin', '<u4'), ('wrMax', '<u4'), ('wrMean', '<u4'),
+                   ('wrCount', '<u2'), ('nbuf', '<u2'), ('audioMax', '<u2'), ('queueMax', '<u2'),
+                   ('delayMax', '<u2'), ('mhz', '<u2'), ('drops', '<u4'), ('allocFail', '<u4'),
+                   ('missing', '<u2', (MAXCH,)), ('sigCount', '<i4'), ('detCount', '<i4'), ('threshold', '<i4'),
+                   ('maxValue', '<u4'), ('maxNoise', '<u4'), ('fastPct', '<u2'), ('mWhh', '<u2')])
+HEADER = np.dtype([('magic', 'S4'), ('size', '<u2'), ('nfile', '<u2'), ('seq', '<u4'), ('reserved', '<u4')])
+SYNC = b'\xa5\x5a'
+TELEMETRY = 0x11 | 0x80  # PROTO_TELEMETRY reply
+VERSION = 1  # TEL_VERSION
+
+
+def crc16(data, crc=0xffff):
+    # CRC-16/CCITT-FALSE as protoCrc (m_proto.h)
+    for b in data:
+        crc ^= b << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else crc << 1
+        crc &= 0xffff
+    return crc
+
+
+def load(name):
+    hdr = np.fromfile(name, dtype=HEADER, count=1)
+    if len(hdr) == 0 or hdr['magic'][0] != b'MTEL' or hdr['size'][0] != RECORD.itemsize:
+        raise ValueError("%s: not a telemetry file of this layout" % name)
+    data = np.fromfile(name, dtype=RECORD, offset=HEADER.itemsize)
+    nseq = int(hdr['seq'][0])
+    data = data[(data['size'] == RECORD.itemsize) & (data['seq'] < nseq)]  # unused slots are zero or stale
+    return data[np.argsort(data['seq'], kind='stable')]
+
+
+def stream(port, seconds):
+    import serial
+    ser = serial.Serial(port, 115200, timeout=0.2)
+    buf = b''
+    t0 = time.time()
+    while not seconds or time.time() - t0 < seconds:
+        buf += ser.read(max(1, ser.in_waiting))
+        while True:
+            ii = buf.find(SYNC)
+            if ii < 0:
+                buf = buf[-1:]
+                break
+            buf = buf[ii:]
+            if len(buf) < 6:
+                break
+            n = struct.unpack('<H', buf[4:6])[0]
+            if len(buf) < 8 + n:
+                break
+            body, crc = buf[2:6 + n], struct.unpack('<H', buf[6 + n:8 + n])[0]
+            if buf[3] != TELEMETRY or n != 1 + RECORD.itemsize or crc16(body) != crc:
+                buf = buf[2:]
+                continue
+            buf = buf[8 + n:]
+            yield np.frombuffer(body[5:], dtype=RECORD)[0]
+
+
+def columns(nch):
+    cols = [c for c in RECORD.names if c not in ('size', 'version', 'missing')]
+    return cols + ["missing%d" % ii for ii in range(nch)]
+
+
+def row(r, nch):
+    vals = [r[c] for c in RECORD.names if c not in ('size', 'version', 'missing')]
+    return ",".join(str(v) for v in vals + list(r['missing'][:nch]))
+
+
+def line(r):
+    return "%s %5d loops  wr %5d/%6d/%6d us %3d  mem %3d  q %3d d %3d  drop %d miss %s  det %d thr %d  sig %d noise %d  %3d MHz %3d%% %.1f mWh/h" % (
+        time.strftime("%H:%M:%S", time.gmtime(r['time'])), r['loops'],
+        -1 if r['wrMin'] == 0xffffffff else r['wrMin'], r['wrMean'], r['wrMax'], r['wrCount'],
+        r['audioMax'], r['queueMax'], r['delayMax'], r['drops'], "/".join(str(m) for m in r['missing'][:r['nch']]),
+        r['detCount'], r['threshold'], r['maxValue'], r['maxNoise'], r['mhz'], r['fastPct'], r['mWhh'] / 10.0)
+
+
+def plot(data, name):
+    import matplotlib
+    matplotlib.use('Agg')
+    import matplotlib.pyplot as plt
+    t = (data['time'] - data['time'][0]) / 3600.0
+    fig, ax = plt.subplots(4, 1, sharex=True, figsize=(10, 9))
+    ax[0].plot(t, data['wrMax'] / 1000.0, label='max')
+    ax[0].plot(t, data['wrMean'] / 1000.0, label='mean')
+    ax[0].set_ylabel('write (ms)')
+    ax[0].legend()
+    ax[1].plot(t, data['audioMax'], label='audio blocks')
+    ax[1].plot(t, data['queueMax'], label='queue')
+    ax[1].legend()
+    ax[2].plot(t, data['drops'], label='dropped frames')
+    ax[2].plot(t, data['missing'][:, :data['nch'][0]].sum(axis=1), label='missing blocks')
+    ax[2].legend()
+    ax[3].semilogy(t, np.maximum(data['maxValue'], 1), label='signal')
+    ax[3].semilogy(t, np.maximum(data['maxNoise'], 1), label='noise')
+    ax[3].legend()
+    ax[3].set_xlabel('hours')
+    fig.savefig(name)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="telemetry records of microSoundRecorder")
+    parser.add_argument('file', nargs='?')
+    parser.add_argument('--port')
+    parser.add_argument('--seconds', type=float)
+    parser.add_argument('--csv')
+    parser.add_argument('--png')
+    args = parser.parse_args()
+
+    if args.port:
+        out = None
+        for r in stream(args.port, args.seconds):
+            if r['version'] != VERSION:
+                continue
+            print(line(r))
+            if args.csv:
+                if out is None:
+                    out = open(args.csv, 'w')
+                    out.write(",".join(columns(r['nch'])) + "\n")
+                out.write(row(r, r['nch']) + "\n")
+                out.flush()
+        return 0
+
+    if not args.file:
+        parser.error("need file or --port")
+    data = load(args.file)
+    data = data[data['version'] == VERSION]
+    if len(data) == 0:
+        print("no records")
+        return 1
+    nch = int(data['nch'][0])
+    print("%d records, %s .. %s" % (len(data), time.strftime("%Y-%m-%d %H:%M:%S", time.gmtime(data['time'][0])),
+                                    time.strftime("%Y-%m-%d %H:%M:%S", time.gmtime(data['time'][-1]))))
+    print("write latency max %d us, audio blocks max %d, dropped frames %d, missing blocks %d"
+          % (data['wrMax'].max(), data['audioMax'].max(), data['drops'].sum(), data['missing'][:, :nch].sum()))
+    if args.csv:
+        with open(args.csv, 'w') as f:
+            f.write(",".join(columns(nch)) + "\n")
+            for r in data:
+                f.write(row(r, nch) + "\n")
+    if args.png:
+        plot(data, args.png)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,37 @@
+#!/usr/bin/env python3
+#
+# Sound Recorder for Teensy 3.6
+# Copyright (c) 2018, Walter Zimmer
+#
+# compares src/bandDetector.py with the firmware (output of test_bands)
+#
+import os
+import sys
+import numpy as np
+
+sys.dont_write_bytecode = True
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "src"))
+import bandDetector  # noqa: E402
+
+
+def main():
+    data, fsamp = bandDetector.loadWav("bands.wav")
+    pow = bandDetector.bandPower(data, fsamp)[:, 0, :]
+    fw = np.loadtxt("bands_pow.txt", ndmin=2)
+    # q15 spectrum of the firmware is truncated to integers: compare where the band holds the bursts
+    sel = pow > 10000
+    err = np.abs(fw[sel] - pow[sel]) / pow[sel]
+    print("band power: %d blocks with signal, relative error median %.4f max %.4f" % (sel.sum(), np.median(err), err.max()))
+    ok = np.median(err) < 0.01 and err.max() < 0.05
+
+    fw = [int(k1) for k1 in np.loadtxt("bands_events.txt", ndmin=2)[:, 0]]
+    host = [int(k1) for k1, _ in bandDetector.detect(pow[:, None, :])]
+    print("events: firmware %s" % fw)
+    print("        host     %s" % host)
+    ok = ok and fw == host
+    print("compare_bands: %s" % ("ok" if ok else "FAILED"))
+    return 0 if ok else 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())
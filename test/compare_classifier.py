@@ -0,0 +1,87 @@
+#!/usr/bin/env python3
+#
+# Sound Recorder for Teensy 3.6
+# Copyright (c) 2018, Walter Zimmer
+#
+# compares src/classifier.py with the firmware (test_classifier)
+# writes a random int8 model and synthetic recordings, scores them with both and checks that
+# - scores are identical with the spectrum rounding of the host FFT (test/host/arm_math.h truncates)
+# - a model with a negative hidden layer shift is rejected by the firmware
+# the deviation from the rounded spectrum of the training features is printed (CMSIS rounds differently again)
+#
+import os
+import sys
+import struct
+import subprocess
+import wave
+import numpy as np
+
+sys.dont_write_bytecode = True
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "src"))
+import classifier  # noqa: E402
+
+FSAMP = 48000
+NFILE = 300
+NMEL, NFRM, BPF, NHID = 16, 16, 4, 32
+
+
+def writeWav(name, x):
+    with wave.open(name, 'wb') as w:
+        w.setnchannels(x.shape[1])
+        w.setsampwidth(2)
+        w.setframerate(FSAMP)
+        w.writeframes(x.astype('<i2').tobytes())
+
+
+def main():
+    rng = np.random.default_rng(3)
+    bins = classifier.melBins(NMEL, FSAMP)
+    layers = [(rng.integers(-20, 21, size=(NHID, NMEL * NFRM)), rng.integers(-2000, 2000, size=NHID), 7, 1),
+              (rng.integers(-30, 31, size=(2, NHID)), rng.integers(-500, 500, size=2), 9, 0)]
+    classifier.writeModel("Model.bin", FSAMP, bins, NFRM, BPF, layers)
+    model = classifier.readModel("Model.bin")
+
+    # tones, chirps and noise of random level and length (also shorter than the feature window), mono and stereo
+    names, host, train = [], [], []
+    t = np.arange(NFRM * BPF * 128 * 2) / FSAMP
+    for ii in range(NFILE):
+        n = int(rng.integers(NFRM * BPF * 128 // 2, len(t)))
+        f0, f1 = rng.uniform(500, 20000, size=2)
+        x = rng.normal(0, rng.uniform(10, 3000), size=n)
+        x += rng.uniform(0, 10000) * np.sin(2 * np.pi * (f0 + (f1 - f0) * t[:n] / t[n - 1] / 2) * t[:n])
+        x = np.clip(x, -32768, 32767).astype(np.int16)
+        nch = 1 + ii % 2
+        xx = np.stack([x] + [x[::-1]] * (nch - 1), axis=1)
+        name = "cls_%03d.wav" % ii
+        writeWav(name, xx)
+        names.append(name)
+        host.append(classifier.infer(model, classifier.features(x, bins, NFRM, BPF, np.floor)))
+        train.append(classifier.infer(model, classifier.features(x, bins, NFRM, BPF)))
+
+    out = subprocess.run(["./test_classifier", "Model.bin"] + names, capture_output=True, text=True)
+    lines = [l.split() for l in out.stdout.splitlines() if not l.startswith('#')]
+    fw = [int(l[1]) for l in lines]
+    print("\n".join(l for l in out.stdout.splitlines() if l.startswith('#')))
+    ok = out.returncode == 0 and len(fw) == NFILE
+    diff = np.abs(np.array(fw) - np.array(host)) if ok else np.array([-1])
+    dtrain = np.abs(np.array(fw) - np.array(train)) if ok else np.array([-1])
+    print("scores: %d files, firmware %d .. %d, difference to classifier.py %d (same rounding), "
+          "%d max %.2f mean (rounded spectrum)" % (len(fw), min(fw), max(fw), diff.max(), dtrain.max(), dtrain.mean()))
+    ok = ok and diff.max() == 0
+
+    # negative shift of a hidden layer must be rejected (right shift by a negative count is undefined)
+    data = bytearray(open("Model.bin", 'rb').read())
+    struct.pack_into('<h', data, 20 + 2 * (NMEL + 1) + 4, -1)
+    open("Model_bad.bin", 'wb').write(data)
+    bad = subprocess.run(["./test_classifier", "Model_bad.bin"], capture_output=True, text=True)
+    print("negative shift: %s" % bad.stdout.strip())
+    ok = ok and bad.returncode == 2
+
+    for name in names:
+        os.remove(name)
+    print("compare_classifier: %s" % ("ok" if ok else "FAILED"))
+    return 0 if ok else 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,32 @@
+#!/usr/bin/env python3
+#
+# Sound Recorder for Teensy 3.6
+# Copyright (c) 2018, Walter Zimmer
+#
+# compares the firmware TDOA (test_tdoa) with src/tdoa.py on the same data
+#
+import os
+import sys
+import numpy as np
+
+sys.dont_write_bytecode = True
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "src"))
+import tdoa  # noqa: E402
+
+NCH = 4
+
+
+def main():
+    data = np.fromfile("tdoa_data.bin", dtype='<i2').reshape(-1, tdoa.NTDOA, NCH)
+    fw = np.loadtxt("tdoa_res.txt", dtype=int, ndmin=2)
+    host = np.array([tdoa.gccPhat(d) for d in data])
+    diff = np.abs(fw - host)
+    # float32 (firmware) and float64 (numpy) may round the interpolated peak to the neighbouring 1/16 sample
+    ok = len(fw) == len(host) and diff.max() <= 1
+    print("tdoa: %d cases, firmware - tdoa.py max %d/16 samples, %d of %d differ" % (len(fw), diff.max(), (diff > 0).sum(), diff.size))
+    print("compare_tdoa: %s" % ("ok" if ok else "FAILED"))
+    return 0 if ok else 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())
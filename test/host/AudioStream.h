@@ -0,0 +1,50 @@
+// host stand-in for the PJRC AudioStream base class
+// blocks are plain heap objects; tests hand blocks to an object with hostInput() and call update()
+#ifndef HOST_AUDIOSTREAM_H
+#define HOST_AUDIOSTREAM_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define AUDIO_BLOCK_SAMPLES 128
+
+typedef struct audio_block_struct
+{ uint8_t  ref_count;
+  uint8_t  reserved1;
+  uint16_t memory_pool_index;
+  int16_t  data[AUDIO_BLOCK_SAMPLES];
+} audio_block_t;
+
+class AudioStream
+{
+public:
+  AudioStream(unsigned char ninput, audio_block_t **iqueue) : num_inputs(ninput), inputQueue(iqueue)
+  { for(int ii=0; ii<ninput; ii++) inputQueue[ii]=NULL; }
+  virtual void update(void) = 0;
+
+  static audio_block_t *allocate(void)
+  { audio_block_t *block = (audio_block_t *) calloc(1, sizeof(audio_block_t));
+    block->ref_count=1;
+    return block;
+  }
+  static void release(audio_block_t *block)
+  { if(block && (--block->ref_count==0)) free(block); }
+
+  // host only: block for input ii (reference is passed to the object)
+  void hostInput(int ii, audio_block_t *block) { inputQueue[ii]=block; }
+
+protected:
+  audio_block_t *receiveReadOnly(unsigned int ii=0)
+  { audio_block_t *block = inputQueue[ii];
+    inputQueue[ii]=NULL;
+    return block;
+  }
+  void transmit(audio_block_t *block, unsigned char ii=0) {}
+
+private:
+  unsigned char num_inputs;
+  audio_block_t **inputQueue;
+};
+
+#endif
@@ -0,0 +1,86 @@
+// host reference of the CMSIS-DSP functions used by the firmware
+// q15 results follow the CMSIS scaling (arm_rfft_q15 of length N returns the DFT divided by N),
+// so fixed point code runs with the same number ranges as on the Teensy
+#ifndef HOST_ARM_MATH_H
+#define HOST_ARM_MATH_H
+
+#include <stdint.h>
+#include <math.h>
+
+typedef int16_t q15_t;
+typedef int32_t q31_t;
+typedef float float32_t;
+typedef int arm_status;
+
+typedef struct { uint32_t fftLenReal; uint32_t ifftFlagR; } arm_rfft_instance_q15;
+typedef struct { uint16_t fftLenRFFT; } arm_rfft_fast_instance_f32;
+
+// twiddle factors exp(-2 pi i k/n) of the last used length
+static inline const double *hostTwiddle(uint32_t n)
+{ static double tw[2*4096];
+  static uint32_t nlast=0;
+  if(n!=nlast)
+  { for(uint32_t kk=0; kk<n; kk++) { tw[2*kk]=cos(2.0*M_PI*kk/n); tw[2*kk+1]=-sin(2.0*M_PI*kk/n);}
+    nlast=n;
+  }
+  return tw;
+}
+
+static inline q15_t hostSat15(int32_t x) { return (x>32767)? 32767: (x<-32768)? -32768: x; }
+
+static inline void arm_mult_q15(const q15_t *a, const q15_t *b, q15_t *dst, uint32_t n)
+{ for(uint32_t ii=0; ii<n; ii++) dst[ii]=hostSat15(((int32_t)a[ii]*b[ii])>>15); }
+
+static inline arm_status arm_rfft_init_q15(arm_rfft_instance_q15 *S, uint32_t n, uint32_t ifftFlag, uint32_t bitReverse)
+{ S->fftLenReal=n; S->ifftFlagR=ifftFlag; return 0; }
+
+// forward transform only; dst holds n complex values (re, im)
+static inline void arm_rfft_q15(const arm_rfft_instance_q15 *S, q15_t *src, q15_t *dst)
+{ uint32_t n=S->fftLenReal;
+  const double *tw=hostTwiddle(n);
+  for(uint32_t kk=0; kk<n; kk++)
+  { double re=0, im=0;
+    for(uint32_t ii=0; ii<n; ii++)
+    { uint32_t jj=(kk*ii)%n;
+      re += src[ii]*tw[2*jj];
+      im += src[ii]*tw[2*jj+1];
+    }
+    dst[2*kk]   = hostSat15((int32_t)floor(re/n));
+    dst[2*kk+1] = hostSat15((int32_t)floor(im/n));
+  }
+}
+
+static inline arm_status arm_rfft_fast_init_f32(arm_rfft_fast_instance_f32 *S, uint16_t n)
+{ S->fftLenRFFT=n; return 0; }
+
+// packed format as CMSIS: [X0, X(n/2), re1, im1, ...]; inverse includes 1/n
+static inline void arm_rfft_fast_f32(arm_rfft_fast_instance_f32 *S, float32_t *src, float32_t *dst, uint8_t ifftFlag)
+{ uint32_t n=S->fftLenRFFT;
+  const double *tw=hostTwiddle(n);
+  if(!ifftFlag)
+  { for(uint32_t kk=0; kk<n/2; kk++)
+    { double re=0, im=0;
+      for(uint32_t ii=0; ii<n; ii++)
+      { uint32_t jj=(kk*ii)%n;
+        re += src[ii]*tw[2*jj];
+        im += src[ii]*tw[2*jj+1];
+      }
+      dst[2*kk]=re; dst[2*kk+1]=im;
+    }
+    double ny=0;
+    for(uint32_t ii=0; ii<n; ii++) ny += (ii&1)? -src[ii]: src[ii];
+    dst[1]=ny;
+  }
+  else
+  { for(uint32_t ii=0; ii<n; ii++)
+    { double x = src[0] + ((ii&1)? -src[1]: src[1]);
+      for(uint32_t kk=1; kk<n/2; kk++)
+      { uint32_t jj=(kk*ii)%n; // exp(+2 pi i k ii/n)
+        x += 2.0*(src[2*kk]*tw[2*jj] + src[2*kk+1]*tw[2*jj+1]);
+      }
+      dst[ii]=x/n;
+    }
+  }
+}
+
+#endif
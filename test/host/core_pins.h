@@ -0,0 +1,37 @@
+// host stand-in for the Teensy core (only what the tested modules use)
+#ifndef HOST_CORE_PINS_H
+#define HOST_CORE_PINS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "kinetis.h"
+
+#ifndef F_CPU
+  #define F_CPU 180000000
+#endif
+#ifndef F_BUS
+  #define F_BUS 60000000
+#endif
+
+static volatile uint32_t hostCycles; // advanced by the tests
+#define ARM_DWT_CYCCNT hostCycles
+#define __disable_irq()
+#define __enable_irq()
+
+static inline uint32_t millis(void) {return hostCycles/(F_CPU/1000);}
+static inline uint32_t micros(void) {return hostCycles/(F_CPU/1000000);}
+
+// USB serial: nothing to read, writes are dropped
+struct hostSerial
+{ void setTimeout(uint32_t) {}
+  size_t readBytes(char *, size_t) {return 0;}
+  size_t write(const uint8_t *, size_t n) {return n;}
+  void send_now(void) {}
+};
+static hostSerial Serial;
+
+#endif
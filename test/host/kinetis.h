@@ -0,0 +1,9 @@
+// host stand-in for the Kinetis registers used by the tested modules
+#ifndef HOST_KINETIS_H
+#define HOST_KINETIS_H
+
+#include <stdint.h>
+
+static volatile uint32_t RTC_TSR; // RTC seconds
+
+#endif
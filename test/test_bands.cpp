@@ -0,0 +1,107 @@
+/* Sound Recorder for Teensy 3.6
+ * Copyright (c) 2018, Walter Zimmer
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+/*
+ * band energy detector (iproc == 2) on the host
+ *
+ * runs mBands and mProcess of the firmware on a synthetic recording (noise and tone bursts in each band)
+ * writes bands.wav, the band powers per block (bands_pow.txt) and the events (bands_events.txt);
+ * compare_bands.py runs src/bandDetector.py on bands.wav and compares both
+ */
+#include "core_pins.h"
+#include "config.h"
+#include "mProcess.h"
+
+int16_t mustClose;
+volatile uint32_t maxValue, maxNoise;
+
+#define NSEC 40
+#define NBLK (NSEC*F_SAMP/AUDIO_BLOCK_SAMPLES)
+
+static int16_t signal[NBLK*AUDIO_BLOCK_SAMPLES];
+static mBands<N_BANDS> bands;
+static mProcess<1> process1(&snipParameters);
+
+static uint32_t seed=1;
+static double gauss(void)
+{ double u1, u2;
+  seed=seed*1664525+1013904223; u1=(seed+1.0)/4294967297.0;
+  seed=seed*1664525+1013904223; u2=(seed+1.0)/4294967297.0;
+  return sqrt(-2.0*log(u1))*cos(2.0*M_PI*u2);
+}
+
+static void writeWav(const char *name, int16_t *data, uint32_t ndat)
+{ FILE *fd=fopen(name, "wb");
+  uint32_t hdr[11]={0x46464952, 36+2*ndat, 0x45564157, 0x20746d66, 16, 0x00010001, F_SAMP, 2*F_SAMP, 0x00100002,
+                    0x61746164, 2*ndat};
+  fwrite(hdr, 4, 11, fd);
+  fwrite(data, 2, ndat, fd);
+  fclose(fd);
+}
+
+int main(void)
+{
+  // noise and 50 ms bursts every 4 s, cycling through the bands
+  const int32_t freq[3]={2500, 6000, 14000};
+  int32_t nburst=0, burst[NSEC];
+  for(int ii=0; ii<NBLK*AUDIO_BLOCK_SAMPLES; ii++) signal[ii]=(int16_t)(100.0*gauss());
+  for(int tt=3; tt<NSEC; tt+=4)
+  { int32_t i0=tt*F_SAMP;
+    for(int ii=0; ii<F_SAMP/20; ii++)
+      signal[i0+ii] += (int16_t)(3000.0*sin(2.0*M_PI*freq[nburst%3]*ii/F_SAMP));
+    burst[nburst++]=i0/AUDIO_BLOCK_SAMPLES;
+  }
+  writeWav("bands.wav", signal, NBLK*AUDIO_BLOCK_SAMPLES);
+
+  // band powers of firmware
+  FILE *fd=fopen("bands_pow.txt", "w");
+  bands.begin(bandParameters, N_BANDS, F_SAMP);
+  for(int kk=0; kk<NBLK; kk++)
+  { int16_t buf[AUDIO_BLOCK_SAMPLES];
+    int32_t pow[N_BANDS];
+    memcpy(buf, &signal[kk*AUDIO_BLOCK_SAMPLES], sizeof(buf));
+    bands.process(buf, pow);
+    for(int jj=0; jj<N_BANDS; jj++) fprintf(fd, "%d%c", pow[jj], (jj<N_BANDS-1)? ' ': '\n');
+  }
+  fclose(fd);
+
+  // detector of firmware (same parameters as src/bandDetector.py)
+  SNIP_Parameters_s param = { 2, 100, 1000, 10000, 38, 375, 0, 0, 1, 0, 0, 0, 0};
+  process1.begin(&param);
+  fd=fopen("bands_events.txt", "w");
+  int32_t nevent=0, nerr=0;
+  for(int kk=0; kk<NBLK; kk++)
+  { audio_block_t *block=AudioStream::allocate();
+    memcpy(block->data, &signal[kk*AUDIO_BLOCK_SAMPLES], sizeof(block->data));
+    process1.hostInput(0, block);
+    process1.update();
+    EVENT_Record_s ev;
+    while(process1.getEvent(&ev))
+    { fprintf(fd, "%u %u\n", ev.block, ev.duration);
+      if((nevent>=nburst) || (ev.block<(uint32_t)burst[nevent]) || (ev.block>(uint32_t)burst[nevent]+1)) nerr++;
+      nevent++;
+    }
+  }
+  fclose(fd);
+
+  printf("test_bands: %d bursts, %d events, %d misplaced\n", nburst, nevent, nerr);
+  return (nevent==nburst && nerr==0)? 0: 1;
+}
@@ -0,0 +1,100 @@
+/* Sound Recorder for Teensy 3.6
+ * Copyright (c) 2018, Walter Zimmer
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+/*
+ * second stage classifier on the host
+ *
+ * runs mClassifier of the firmware on wav files
+ * usage: test_classifier Model.bin file.wav [file.wav ...]
+ * prints the score of each file and the host time of the firmware code per block and per inference;
+ * exit code 2 if the model is rejected (compare_classifier.py drives this test)
+ */
+#include <chrono>
+#include "core_pins.h"
+#include "config.h"
+#include "m_classifier.h"
+
+static mClassifier classifier;
+static int16_t data[F_SAMP*60*2];
+
+// samples of a 16 bit wav file (all channels, interleaved); returns number of frames
+static int32_t loadWav(const char *name, int16_t *nch)
+{ FILE *fd=fopen(name, "rb");
+  if(!fd) return -1;
+  uint8_t hdr[12];
+  int32_t nframe=-1;
+  if(fread(hdr, 1, 12, fd)==12 && !memcmp(hdr, "RIFF", 4) && !memcmp(hdr+8, "WAVE", 4))
+  { uint8_t chunk[8];
+    while(fread(chunk, 1, 8, fd)==8)
+    { uint32_t len=chunk[4] | (chunk[5]<<8) | (chunk[6]<<16) | ((uint32_t)chunk[7]<<24);
+      if(!memcmp(chunk, "fmt ", 4))
+      { uint8_t fmt[16];
+        if(fread(fmt, 1, 16, fd)!=16) break;
+        *nch=fmt[2] | (fmt[3]<<8);
+        fseek(fd, len-16, SEEK_CUR);
+      }
+      else if(!memcmp(chunk, "data", 4))
+      { uint32_t nmax=sizeof(data)/sizeof(data[0]);
+        uint32_t ndat=len/2;
+        if(ndat>nmax) ndat=nmax;
+        nframe=fread(data, 2, ndat, fd)/(*nch);
+        break;
+      }
+      else fseek(fd, len, SEEK_CUR);
+    }
+  }
+  fclose(fd);
+  return nframe;
+}
+
+int main(int argc, char **argv)
+{
+  if(argc<2) { printf("usage: test_classifier Model.bin file.wav [file.wav ...]\n"); return 1;}
+  FILE *fd=fopen(argv[1], "rb");
+  if(!fd) { printf("%s: not found\n", argv[1]); return 1;}
+  int32_t nbytes=fread(classifier.getBuffer(), 1, CLS_MAXMODEL, fd);
+  fclose(fd);
+  if(!classifier.begin(nbytes, F_SAMP)) { printf("model rejected\n"); return 2;}
+
+  double tblk=0, tinf=0;
+  int32_t nblk=0, ninf=0;
+  for(int ff=2; ff<argc; ff++)
+  { int16_t nch=1;
+    int32_t nframe=loadWav(argv[ff], &nch);
+    if(nframe<0) { printf("%s: no wav file\n", argv[ff]); return 1;}
+    auto t0=std::chrono::steady_clock::now();
+    classifier.reset();
+    for(int kk=0; kk<nframe/AUDIO_BLOCK_SAMPLES; kk++) // only full blocks are stored
+    { classifier.addBlock(&data[kk*AUDIO_BLOCK_SAMPLES*nch], nch);
+      nblk++;
+    }
+    auto t1=std::chrono::steady_clock::now();
+    int16_t score=classifier.score();
+    auto t2=std::chrono::steady_clock::now();
+    tblk += std::chrono::duration<double>(t1-t0).count();
+    tinf += std::chrono::duration<double>(t2-t1).count();
+    ninf++;
+    printf("%s %d\n", argv[ff], score);
+  }
+  // features use the host reference FFT of host/arm_math.h (not the CMSIS code), so only inference time is indicative
+  if(ninf) printf("# host: %.2f us per block (features), %.2f us per inference\n", 1e6*tblk/(nblk? nblk: 1), 1e6*tinf/ninf);
+  return 0;
+}
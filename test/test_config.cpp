@@ -0,0 +1,111 @@
+/* Sound Recorder for Teensy 3.6
+ * Copyright (c) 2018, Walter Zimmer
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+/*
+ * configuration store (m_config.h) on the host
+ *
+ * previous format files as written by the first firmware (8 acq, 8 snip values, name) and by later
+ * versions (all snip values), key=value files (round trip also of the compiled defaults, crc, range) and rejected files
+ */
+#include "core_pins.h"
+#include "config.h"
+#define NCH 2
+#if MDEL>0
+  #define NDEL_MAX (MDEL+50) // myAPP.cpp: MDEL+MQ/2
+#else
+  #define NDEL_MAX 0
+#endif
+#include "m_config.h"
+
+static char text[CFG_MAXTEXT];
+static int nfail=0;
+
+static void check(const char *name, int ok)
+{ printf("%-40s %s\n", name, ok? "ok": "FAILED");
+  if(!ok) nfail++;
+}
+
+// previous format file of nsnip snip values
+static int32_t legacyFile(ACQ_Parameters_s *acq, SNIP_Parameters_s *snip, int nsnip)
+{ int32_t n=0;
+  for(int ii=0; ii<8; ii++) n+=sprintf(text+n, "%10d\r\n", (int)((uint32_t *)acq)[ii]);
+  for(int ii=0; ii<nsnip; ii++) n+=sprintf(text+n, "%10d\r\n", (int)((int32_t *)snip)[ii]);
+  n+=sprintf(text+n, "%s\r\n", acq->name);
+  return n;
+}
+
+int main(void)
+{
+  const char *err="";
+  ACQ_Parameters_s acq0=acqParameters, acq;
+  SNIP_Parameters_s snip0=snipParameters, snip;
+  ACQ_Parameters_s acqf={ 120, 60, 600, 1, 11, 13, 23, 1, "ABCD"};
+  SNIP_Parameters_s snipf={ 2, 200, 900, 9000, 40, 400, 100, NDEL_MAX, 2, 30, 50, 70, 60};
+
+  // first format: 8 snip values, the appended ones keep their defaults
+  int32_t n=legacyFile(&acqf, &snipf, 8);
+  acq=acq0; snip=snip0;
+  int16_t ret=cfgParse(text, n, &acq, &snip, &err);
+  check("previous format, 8 snip values", ret==2 && !memcmp(&acq, &acqf, sizeof(acq))
+        && !memcmp(&snip, &snipf, 8*sizeof(int32_t))
+        && !memcmp((int32_t *)&snip+8, (int32_t *)&snip0+8, sizeof(snip)-8*sizeof(int32_t)));
+
+  // later format: all snip values
+  n=legacyFile(&acqf, &snipf, N_SNIP_PARAMETERS);
+  acq=acq0; snip=snip0;
+  ret=cfgParse(text, n, &acq, &snip, &err);
+  check("previous format, all snip values", ret==2 && !memcmp(&acq, &acqf, sizeof(acq)) && !memcmp(&snip, &snipf, sizeof(snip)));
+
+  // too short
+  n=legacyFile(&acqf, &snipf, 0);
+  n=sprintf(text+7*12, "%s\r\n", acqf.name)+7*12;
+  acq=acq0; snip=snip0;
+  ret=cfgParse(text, n, &acq, &snip, &err);
+  check("previous format, 7 values rejected", ret==0 && !memcmp(&acq, &acq0, sizeof(acq)));
+
+  // key=value round trip
+  n=cfgFormat(text, sizeof(text), &acqf, &snipf);
+  acq=acq0; snip=snip0;
+  ret=cfgParse(text, n, &acq, &snip, &err);
+  check("key=value round trip", ret==1 && !memcmp(&acq, &acqf, sizeof(acq)) && !memcmp(&snip, &snipf, sizeof(snip)));
+
+  // compiled defaults (as stored on first boot)
+  n=cfgFormat(text, sizeof(text), &acq0, &snip0);
+  acq=acqf; snip=snipf;
+  ret=cfgParse(text, n, &acq, &snip, &err);
+  check("key=value, compiled defaults round trip", ret==1 && !memcmp(&acq, &acq0, sizeof(acq)) && !memcmp(&snip, &snip0, sizeof(snip)));
+
+  // crc mismatch
+  n=cfgFormat(text, sizeof(text), &acqf, &snipf);
+  strstr(text, "on=")[3]='9';
+  acq=acq0; snip=snip0;
+  ret=cfgParse(text, n, &acq, &snip, &err);
+  check("key=value, crc mismatch rejected", ret==0 && !strcmp(err, "crc mismatch") && !memcmp(&acq, &acq0, sizeof(acq)));
+
+  // hand edited file without crc: out of range value
+  n=sprintf(text, "version=2\r\nT1=25\r\n");
+  acq=acq0; snip=snip0;
+  ret=cfgParse(text, n, &acq, &snip, &err);
+  check("key=value, out of range rejected", ret==0 && !strcmp(err, "value out of range"));
+
+  printf("test_config: %s\n", nfail? "FAILED": "ok");
+  return nfail? 1: 0;
+}
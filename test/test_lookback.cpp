@@ -0,0 +1,89 @@
+/* Sound Recorder for Teensy 3.6
+ * Copyright (c) 2018, Walter Zimmer
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+/*
+ * compressed look-back (m_lookback.h) on the host
+ *
+ * pushes more blocks than the ring holds and checks that pop() returns the newest capacity() blocks,
+ * oldest first, with the IMA-ADPCM round-trip SNR of white noise and of a tone
+ */
+#include <math.h>
+#include <random>
+#include "core_pins.h"
+#include "config.h"
+#include "m_lookback.h"
+
+#define TNCH 2
+#define TBYTES (64*TNCH*LB_CHBYTES)
+#define NPUSH 100
+
+static mLookBack<TNCH,TBYTES> lookBack;
+static int16_t data[NPUSH][AUDIO_BLOCK_SAMPLES*TNCH];
+
+// round-trip SNR (dB) per channel; returns 0 if ring order or length is wrong
+static int roundTrip(const char *name, double *snr)
+{
+  int ncap=lookBack.capacity();
+  for(int kk=0; kk<NPUSH; kk++) lookBack.push(data[kk]);
+  if(lookBack.available()!=ncap) { printf("%s: %d blocks available, expected %d\n", name, lookBack.available(), ncap); return 0;}
+  double sig[TNCH]={0}, err[TNCH]={0};
+  int16_t out[AUDIO_BLOCK_SAMPLES*TNCH];
+  for(int kk=NPUSH-ncap; kk<NPUSH; kk++)
+  { if(!lookBack.pop(out)) { printf("%s: ring empty at block %d\n", name, kk); return 0;}
+    for(int ii=0; ii<AUDIO_BLOCK_SAMPLES*TNCH; ii++)
+    { double d=data[kk][ii], e=out[ii]-d;
+      sig[ii%TNCH] += d*d;
+      err[ii%TNCH] += e*e;
+    }
+  }
+  if(lookBack.pop(out)) { printf("%s: ring not empty\n", name); return 0;}
+  for(int ch=0; ch<TNCH; ch++) snr[ch]=10*log10(sig[ch]/(err[ch]+1e-9));
+  printf("%s: %d of %d blocks, SNR %.1f / %.1f dB\n", name, ncap, NPUSH, snr[0], snr[1]);
+  return 1;
+}
+
+int main(void)
+{
+  std::mt19937 gen(1);
+  std::normal_distribution<double> noise(0.0, 3000.0);
+  double snr[TNCH];
+  int ok=1;
+
+  // white noise (different on both channels)
+  for(int kk=0; kk<NPUSH; kk++) for(int ii=0; ii<AUDIO_BLOCK_SAMPLES*TNCH; ii++)
+  { double v=noise(gen);
+    data[kk][ii]=(v>32767)? 32767: (v<-32768)? -32768: (int16_t)v;
+  }
+  ok &= roundTrip("white noise", snr);
+  ok &= (snr[0]>=13 && snr[1]>=13);
+
+  // tone of 1 kHz and 5 kHz (channel 0 and 1)
+  for(int kk=0; kk<NPUSH; kk++) for(int ii=0; ii<AUDIO_BLOCK_SAMPLES; ii++)
+  { double t=(double)(kk*AUDIO_BLOCK_SAMPLES+ii)/F_SAMP;
+    data[kk][ii*TNCH]  =(int16_t)(10000*sin(2*M_PI*1000*t));
+    data[kk][ii*TNCH+1]=(int16_t)(10000*sin(2*M_PI*5000*t));
+  }
+  ok &= roundTrip("tone", snr);
+  ok &= (snr[0]>=35 && snr[1]>=20);
+
+  printf("test_lookback: %s\n", ok? "ok": "FAILED");
+  return ok? 0: 1;
+}
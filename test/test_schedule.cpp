@@ -0,0 +1,109 @@
+/* Sound Recorder for Teensy 3.6
+ * Copyright (c) 2018, Walter Zimmer
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+/*
+ * acquisition schedule (m_schedule.h) on the host
+ *
+ * five-day scan in minute steps per case: active minutes per day against the expected value,
+ * first switch-on time against the published sunrise or sunset (local time, +-5 minutes)
+ * and isActive() / nextChange() consistency (nextChange is where isActive changes or the horizon ends at midnight);
+ * parse() status on reload and on text without rules
+ */
+#include "m_schedule.h"
+
+#define NDAYS 5
+#define DAY_JUN21 20625 // 2026-06-21 (days since 1970)
+#define DAY_DEC21 20808 // 2026-12-21
+
+typedef struct
+{ const char *name;
+  const char *text;
+  int32_t day;
+  int32_t minutes;  // expected active minutes per day (+-tol)
+  int32_t tol;
+  int32_t start;    // expected first switch-on in local minutes of the day (-1: not checked)
+} CASE_s;
+
+static const CASE_s cases[] = {
+  {"Munich SR", "lat 48.14\nlon 11.58\ntz 120\n* SR-30 SR+90\n", DAY_JUN21, 120, 0, 5*60+12-30},
+  {"Munich SS over midnight", "lat 48.14\nlon 11.58\ntz 120\n* SS-60 01:00\n", DAY_JUN21, 4*60+43, 3, 21*60+17-60},
+  {"Sydney SR", "lat -33.87\nlon 151.21\ntz 600\n* SR-30 SR+90\n", DAY_JUN21, 120, 0, 7*60-30},
+  {"Sydney SR (RTC in UTC)", "lat -33.87\nlon 151.21\ntz 0\n* SR-30 SR+90\n", DAY_JUN21, 120, 0, 21*60-30},
+  {"Sydney day", "lat -33.87\nlon 151.21\ntz 600\n1-7 SR SS\n", DAY_JUN21, 9*60+54, 3, 7*60},
+  {"Los Angeles SS", "lat 34.05\nlon -118.24\ntz -420\n* SS-60 SS\n", DAY_JUN21, 60, 0, 20*60+8-60},
+  {"Svalbard midnight sun", "lat 78.2\nlon 15.6\ntz 60\n* SR SS\n", DAY_JUN21, 1440, 0, -1},
+  {"Svalbard polar night", "lat 78.2\nlon 15.6\ntz 60\n* SR SS\n* 10:00 11:00\n", DAY_DEC21, 60, 0, 10*60},
+};
+
+static int runCase(const CASE_s *c)
+{
+  mSchedule sched;
+  if(!sched.parse(c->text, strlen(c->text))) { printf("%s: no rules\n", c->name); return 0;}
+  uint32_t t0 = (uint32_t)c->day*86400;
+  int ok=1, nerr=0;
+  int32_t start=-1;
+  int16_t last=sched.isActive(t0-60);
+  printf("%-26s", c->name);
+  for(int dd=0; dd<NDAYS; dd++)
+  { int32_t active=0;
+    for(uint32_t tt=t0+dd*86400; tt<t0+(dd+1)*86400; tt+=60)
+    { int16_t a=sched.isActive(tt);
+      active += a;
+      if(a && !last && start<0) start=(tt-t0)/60;
+      last=a;
+      uint32_t tn=sched.nextChange(tt);
+      if(tn<=tt || (sched.isActive(tn-60)!=a)) nerr++;
+      else if((sched.isActive(tn)==a) && (tn%86400)) nerr++;
+    }
+    printf(" %4d", active);
+    if(abs(active-c->minutes)>c->tol) ok=0;
+  }
+  if(c->start>=0 && abs(start-c->start)>5) ok=0;
+  if(nerr) ok=0;
+  if(start>=0) printf("  on %02d:%02d", start/60, start%60); else printf("  on   -  ");
+  printf("  %s\n", nerr? "inconsistent": ok? "ok": "FAILED");
+  return ok;
+}
+
+// reload with the same number of rules is reported as loaded; a text without rules keeps rules and position
+static int reloadCase(void)
+{
+  mSchedule sched;
+  const char *t1="lat 48.14\nlon 11.58\ntz 120\n* SR-30 SR+90\n";
+  const char *t2="lat 48.14\nlon 11.58\ntz 120\n* 10:00 11:00\n";
+  const char *t3="lat -33.87\nlon 151.21\ntz 600\n# no rules\n";
+  uint32_t t0=(uint32_t)DAY_JUN21*86400;
+  int ok = (sched.parse(t1, strlen(t1))==1) && (sched.parse(t2, strlen(t2))==1) && (sched.parse(t1, strlen(t1))==1);
+  uint32_t on=sched.nextChange(t0);
+  ok &= (sched.parse(t3, strlen(t3))==0) && (sched.nextChange(t0)==on);
+  printf("%-26s %s\n", "reload / no rules", ok? "ok": "FAILED");
+  return ok;
+}
+
+int main(void)
+{
+  int ok=1;
+  printf("%-26s active minutes per day (%d days)\n", "", NDAYS);
+  for(uint32_t ii=0; ii<sizeof(cases)/sizeof(cases[0]); ii++) ok &= runCase(&cases[ii]);
+  ok &= reloadCase();
+  printf("test_schedule: %s\n", ok? "ok": "FAILED");
+  return ok? 0: 1;
+}
@@ -0,0 +1,111 @@
+/* Sound Recorder for Teensy 3.6
+ * Copyright (c) 2018, Walter Zimmer
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+/*
+ * TDOA estimator (m_tdoa.h) on the host
+ *
+ * broadband click (sum of random sinusoids, decaying envelope) evaluated at t-d for each channel,
+ * so integer and fractional delays are exact; the two blocks are passed through start() and capture()
+ * as in mProcess. checks estimates against the true delays and writes
+ *   tdoa_data.bin  int16 samples (NTDOA x nch per case, interleaved)
+ *   tdoa_res.txt   firmware delays (1/16 sample) per case
+ * for compare_tdoa.py (src/tdoa.py on the same data)
+ */
+#include <math.h>
+#include <random>
+#include "core_pins.h"
+#include "config.h"
+#include "m_tdoa.h"
+
+#define TNCH 4
+#define NCASE 40
+#define NSIN 200
+
+static mTdoa<TNCH> tdoa;
+static int16_t data[NTDOA][TNCH];
+
+static float fixed[][TNCH] = {
+  {0, 5, -12, 30}, {0, -1, 1, -64}, {0, 64, -40, 2},          // integer
+  {0, 3.5f, -7.25f, 20.75f}, {0, 0.25f, -0.5f, 12.125f}};     // fractional
+
+int main(void)
+{
+  std::mt19937 gen(7);
+  std::uniform_real_distribution<double> uni(0.0, 1.0);
+  FILE *fd=fopen("tdoa_data.bin", "wb");
+  FILE *fr=fopen("tdoa_res.txt", "w");
+  int nfail=0;
+  double emax[2]={0,0}; // integer, fractional
+  tdoa.begin();
+  for(int cc=0; cc<NCASE; cc++)
+  { float dly[TNCH];
+    int nfix=sizeof(fixed)/sizeof(fixed[0]);
+    for(int kk=0; kk<TNCH; kk++)
+      dly[kk] = (cc<nfix)? fixed[cc][kk]: (kk==0)? 0: (float)((uni(gen)-0.5)*TDOA_MAXLAG*((cc&1)? 1.0: 1.5)); // some beyond search range / 2
+    int frac=0;
+    for(int kk=1; kk<TNCH; kk++) if(dly[kk]!=floorf(dly[kk])) frac=1;
+    double f[NSIN], ph[NSIN];
+    for(int ii=0; ii<NSIN; ii++) { f[ii]=0.02+0.45*uni(gen); ph[ii]=2*M_PI*uni(gen);}
+    static double sig[NTDOA][TNCH];
+    double vmax=0;
+    for(int kk=0; kk<TNCH; kk++)
+      for(int nn=0; nn<NTDOA; nn++)
+      { double t=nn-NTDOA/4-dly[kk], v=0;
+        if(t>=0)
+        { for(int ii=0; ii<NSIN; ii++) v += sin(2*M_PI*f[ii]*t+ph[ii]);
+          v *= exp(-t/40.0);
+        }
+        sig[nn][kk]=v;
+        if(fabs(v)>vmax) vmax=fabs(v);
+      }
+    for(int kk=0; kk<TNCH; kk++)
+      for(int nn=0; nn<NTDOA; nn++) data[nn][kk]=(int16_t)lrint(16000*sig[nn][kk]/vmax);
+    // trigger block and following block as in mProcess::update
+    tdoa.start(cc);
+    for(int bb=0; bb<2; bb++)
+    { audio_block_t blk[TNCH], *inp[TNCH];
+      for(int kk=0; kk<TNCH; kk++)
+      { for(int nn=0; nn<AUDIO_BLOCK_SAMPLES; nn++) blk[kk].data[nn]=data[bb*AUDIO_BLOCK_SAMPLES+nn][kk];
+        inp[kk]=&blk[kk];
+      }
+      tdoa.capture(inp);
+    }
+    if(!tdoa.isReady()) { printf("case %d: not ready\n", cc); return 1;}
+    int16_t res[7];
+    tdoa.compute(res);
+    fwrite(data, sizeof(data), 1, fd);
+    for(int kk=1; kk<TNCH; kk++)
+    { fprintf(fr, "%d ", res[kk-1]);
+      if(fabsf(dly[kk])>TDOA_MAXLAG) continue; // outside search range
+      double e=fabs(res[kk-1]/16.0-dly[kk]);
+      if(e>emax[frac]) emax[frac]=e;
+    }
+    fprintf(fr, "\n");
+  }
+  fclose(fd);
+  fclose(fr);
+  // integer delays: parabola of a symmetric peak, fractional: bias of the parabolic interpolation
+  if(emax[0]>1.0/16) nfail++;
+  if(emax[1]>0.25) nfail++;
+  printf("test_tdoa: %d cases, max error %.3f samples (integer delays), %.3f samples (fractional): %s\n",
+         NCASE, emax[0], emax[1], nfail? "FAILED": "ok");
+  return nfail? 1: 0;
+}